@@ -0,0 +1,293 @@
+// Offline asset cooker: turns the meshes and images of a directory into the
+// files the demo maps as is. It needs no GL context, so it runs on build hosts.
+//
+// usage: assetcook <input directory> <output directory> [--compress] [--bc7] [--threads=N] [--force]
+//
+// OBJ and PLY meshes become "<name>.mesh" (see meshcache.h), PNG, BMP, JPEG
+// and TGA images "<name>.tex" (see texturefile.h), under the same relative
+// path; --compress stores textures BC1/BC3 and meshes encoded (see
+// meshcodec.h), --bc7 textures BC7 instead. cook.manifest, in the output
+// directory, records what every output was cooked from and with which
+// settings, so that later runs only cook what changed (--force cooks all).
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "utils/meshcache.h"
+#include "utils/sourceinfo.h"
+#include "utils/texturefile.h"
+#include "utils/ThreadPool.h"
+#include "utils/Timer.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "utils/stb_image.h"
+
+#define TINYPLY_IMPLEMENTATION
+#include <tinyply.h>
+
+namespace {
+
+const char* const kManifestName = "cook.manifest";
+
+enum class AssetKind
+{
+	Mesh,
+	Texture
+};
+
+struct CookItem
+{
+	std::string input;  // relative to the input directory
+	std::string output; // relative to the output directory
+	AssetKind kind;
+	std::string settings;
+	SourceInfo source;
+	bool stale = true;
+	bool failed = false;
+};
+
+// What an output was cooked from, by output
+struct ManifestRecord
+{
+	std::string input;
+	std::string settings;
+	SourceInfo source;
+};
+
+using Manifest = std::map<std::string, ManifestRecord>;
+
+// One line per output: output, input, settings, size, time and hash, tab separated
+bool readManifest(const std::string& path, Manifest& manifest)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file)
+		return false;
+	char line[4096];
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#')
+			continue;
+		char* fields[6];
+		int count = 0;
+		for (char* p = line; count < 6 && p; count++)
+		{
+			fields[count] = p;
+			p = strpbrk(p, "\t\n");
+			if (p)
+				*p++ = '\0';
+		}
+		if (count < 6)
+			continue;
+		ManifestRecord& record = manifest[fields[0]];
+		record.input = fields[1];
+		record.settings = fields[2];
+		record.source.size = strtoull(fields[3], nullptr, 10);
+		record.source.time = strtoll(fields[4], nullptr, 10);
+		record.source.hash = strtoull(fields[5], nullptr, 16);
+	}
+	fclose(file);
+	return true;
+}
+
+bool writeManifest(const std::string& path, const Manifest& manifest)
+{
+	const std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+	if (!file)
+		return false;
+	fprintf(file, "# output\tinput\tsettings\tsize\ttime\thash\n");
+	for (const auto& entry : manifest)
+	{
+		const ManifestRecord& record = entry.second;
+		fprintf(file, "%s\t%s\t%s\t%llu\t%lld\t%016llx\n", entry.first.c_str(), record.input.c_str(), record.settings.c_str(),
+			(unsigned long long)record.source.size, (long long)record.source.time, (unsigned long long)record.source.hash);
+	}
+	bool ok = fclose(file) == 0;
+	std::error_code error;
+	if (ok)
+		std::filesystem::rename(temporary, path, error);
+	return ok && !error;
+}
+
+const char* const kCompressionSettings[] = { "-rgba8", "-bc", "-bc7" };
+
+bool classify(const std::string& path, bool compress, TextureCompression textureCompression, AssetKind& kind, std::string& output, std::string& settings)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+
+	if (extension == ".obj" || extension == ".ply")
+	{
+		kind = AssetKind::Mesh;
+		output = path + ".mesh";
+		settings = "mesh-v" + std::to_string(kMeshFileVersion) + (compress ? "-encoded" : "");
+		return true;
+	}
+	if (extension == ".png" || extension == ".bmp" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga")
+	{
+		kind = AssetKind::Texture;
+		output = path + ".tex";
+		settings = "texture-v" + std::to_string(kTextureFileVersion) + kCompressionSettings[(int)textureCompression];
+		return true;
+	}
+	return false;
+}
+
+// Up to date when cooked from the same input with the same settings, and the
+// input did not change: same size, and same time or else same content
+bool isUpToDate(CookItem& item, const Manifest& manifest, const std::string& inputPath, const std::string& outputPath)
+{
+	const auto found = manifest.find(item.output);
+	if (found == manifest.end() || !std::filesystem::exists(outputPath))
+		return false;
+	const ManifestRecord& record = found->second;
+	if (record.input != item.input || record.settings != item.settings || record.source.size != item.source.size)
+		return false;
+	if (record.source.time == item.source.time)
+	{
+		item.source.hash = record.source.hash;
+		return true;
+	}
+	return getSourceInfo(inputPath.c_str(), item.source, true) && item.source.hash == record.source.hash;
+}
+
+bool cook(CookItem& item, const std::string& inputPath, const std::string& outputPath, bool compress, TextureCompression textureCompression)
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(outputPath).parent_path(), error);
+	if (!item.source.hash && !getSourceInfo(inputPath.c_str(), item.source, true))
+		return false;
+
+	if (item.kind == AssetKind::Texture)
+		return cookTexture(inputPath.c_str(), outputPath.c_str(), textureCompression, item.source);
+
+	Mesh mesh;
+	if (!buildMesh(inputPath.c_str(), mesh))
+		return false;
+	return writeMeshFile(outputPath.c_str(), viewMesh(mesh, computeBounds(mesh.positions)), item.source, compress);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const char* inputDirectory = nullptr;
+	const char* outputDirectory = nullptr;
+	bool compress = false, force = false;
+	TextureCompression textureCompression = TextureCompression::None;
+	unsigned threads = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--compress") == 0)
+		{
+			compress = true;
+			if (textureCompression == TextureCompression::None)
+				textureCompression = TextureCompression::S3TC;
+		}
+		else if (strcmp(argv[i], "--bc7") == 0)
+			textureCompression = TextureCompression::BC7;
+		else if (strcmp(argv[i], "--force") == 0)
+			force = true;
+		else if (strncmp(argv[i], "--threads=", 10) == 0)
+			threads = (unsigned)atoi(argv[i] + 10);
+		else if (!inputDirectory)
+			inputDirectory = argv[i];
+		else if (!outputDirectory)
+			outputDirectory = argv[i];
+	}
+	if (!inputDirectory || !outputDirectory)
+	{
+		fprintf(stderr, "usage: assetcook <input directory> <output directory> [--compress] [--bc7] [--threads=N] [--force]\n");
+		return EXIT_FAILURE;
+	}
+
+	Timer timer;
+	const std::filesystem::path inputRoot(inputDirectory), outputRoot(outputDirectory);
+	const std::string manifestPath = (outputRoot / kManifestName).string();
+	Manifest manifest;
+	if (!force)
+		readManifest(manifestPath, manifest);
+
+	std::vector<CookItem> items;
+	std::error_code error;
+	for (auto it = std::filesystem::recursive_directory_iterator(inputRoot, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		if (!it->is_regular_file())
+			continue;
+		CookItem item;
+		item.input = std::filesystem::relative(it->path(), inputRoot).generic_string();
+		if (classify(item.input, compress, textureCompression, item.kind, item.output, item.settings))
+			items.push_back(std::move(item));
+	}
+	if (error)
+	{
+		fprintf(stderr, "Could not list %s: %s\n", inputDirectory, error.message().c_str());
+		return EXIT_FAILURE;
+	}
+
+	auto inputPath = [&](const CookItem& item) { return (inputRoot / item.input).string(); };
+	auto outputPath = [&](const CookItem& item) { return (outputRoot / item.output).string(); };
+
+	// Checking needs hashing whenever a time changed, so it is spread too
+	ThreadPool& pool = ThreadPool::shared();
+	pool.parallelFor(items.size(), [&](size_t i)
+	{
+		CookItem& item = items[i];
+		item.failed = !getSourceInfo(inputPath(item).c_str(), item.source, false);
+		item.stale = !item.failed && !isUpToDate(item, manifest, inputPath(item), outputPath(item));
+	}, threads);
+
+	// Largest inputs first, so that they do not end up alone on one core
+	std::vector<CookItem*> stale;
+	for (CookItem& item : items)
+		if (item.stale)
+			stale.push_back(&item);
+	std::sort(stale.begin(), stale.end(), [](const CookItem* a, const CookItem* b) { return a->source.size > b->source.size; });
+
+	std::atomic<size_t> failures{ 0 };
+	pool.parallelFor(stale.size(), [&](size_t i)
+	{
+		CookItem& item = *stale[i];
+		item.failed = !cook(item, inputPath(item), outputPath(item), compress, textureCompression);
+		if (item.failed)
+		{
+			fprintf(stderr, "Could not cook %s\n", item.input.c_str());
+			failures++;
+		}
+	}, threads);
+
+	// Outputs whose input is gone are removed, failed ones cooked again next time
+	Manifest cooked;
+	for (const CookItem& item : items)
+		if (!item.failed)
+			cooked[item.output] = { item.input, item.settings, item.source };
+	size_t removed = 0;
+	for (const auto& entry : manifest)
+	{
+		if (cooked.count(entry.first))
+			continue;
+		bool inputStillThere = false;
+		for (const CookItem& item : items)
+			inputStillThere |= item.output == entry.first;
+		if (!inputStillThere && std::filesystem::remove(outputRoot / entry.first, error))
+			removed++;
+	}
+
+	std::filesystem::create_directories(outputRoot, error);
+	if (!writeManifest(manifestPath, cooked))
+	{
+		fprintf(stderr, "Could not write %s\n", manifestPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	printf("Cooked %zu of %zu assets (%zu failed, %zu removed) in %.2f s\n",
+		stale.size() - failures, items.size(), (size_t)failures, removed, timer.elapsed());
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
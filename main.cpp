@@ -4,17 +4,34 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/string_cast.hpp>
 
+#include <map>
 #include <vector>
 #include <iostream>
 #include <random>
 #include <sstream>
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
 
 #include "utils/Timer.h"
+#include "utils/AssetPack.h"
 #include "utils/Shader.h"
 #include "utils/texture.h"
 #include "utils/objloader.hpp"
+#include "utils/meshcache.h"
+#include "utils/gpumesh.h"
+#include "utils/gputexture.h"
+#include "utils/MeshLoader.h"
+#include "utils/TextureArrays.h"
+#include "utils/TextureManager.h"
+#include "utils/UploadRing.h"
+#include "utils/VirtualTexture.h"
+#include "utils/meshlet.h"
+#include "utils/plyloader.h"
+#include "utils/simplify.h"
+#include "utils/texturefile.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "utils/stb_image.h"
@@ -27,6 +44,8 @@
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 
+static void toggleMeshLayout();
+
 static void error_callback(int /*error*/, const char* description)
 {
 	std::cerr << "Error: " << description << std::endl;
@@ -36,20 +55,16 @@ static void key_callback(GLFWwindow* window, int key, int /*scancode*/, int acti
 {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GLFW_TRUE);
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+		toggleMeshLayout();
 }
 
-GLuint MakeShader(GLuint t, std::string path)
+GLuint MakeShader(GLuint t, ByteSpan source)
 {
-	std::cout << path << std::endl;
-	std::ifstream file(path.c_str(), std::ios::in);
-	std::ostringstream contents;
-	contents << file.rdbuf();
-	file.close();
-	const auto content = contents.str();
-	std::cout << content << std::endl;
+	std::cout.write(source.data, source.size) << std::endl;
 	const auto s = glCreateShader(t);
-	GLint sizes[] = { (GLint)content.size() };
-	const auto data = content.data();
+	GLint sizes[] = { (GLint)source.size };
+	const auto data = source.data;
 	glShaderSource(s, 1, &data, sizes);
 	glCompileShader(s);
 	GLint success;
@@ -98,35 +113,149 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 }
 
 static void processCameraInput(GLFWwindow* window, float deltaTime);
-unsigned int loadTexture(const char* path);
+static void followCameraPath(float time);
+Shader loadShader(const char* vertexName, const char* fragmentName);
+
+// What the meshes of a pass are culled and their level of detail picked with
+struct ScenePass
+{
+	const char* name = "";
+	glm::mat4 viewProjection = glm::mat4(1.f);
+	const glm::vec3* eye = nullptr; // camera position, none for the shadow pass
+	float pixelsPerUnit = 0.f;      // pixels covered by one world unit, at distance 1 when there is an eye
+	float maxLodPixels = 1.f;       // error allowed when picking a level of detail
+
+	MeshletCullStats cullStats;
+	uint64_t lodDraws[kMaxMeshLods] = {};
+};
 
-void renderScene(const Shader& shader, float rotate);
+static void printPassStats(const ScenePass& pass, unsigned frames);
+static int benchmarkMeshLoading(const char* objPath);
+static int cookAssetPack();
+
+void renderScene(const Shader& shader, float rotate, ScenePass& pass);
 void renderCube();
-void renderMajoraMask();
+void renderMajoraMask(const Shader& shader, const glm::mat4& model, ScenePass& pass);
 void renderQuad();
 
 glm::vec3 position = glm::vec3(0.f, 2.f, 10.f);
 glm::vec2 lmp;
 float pitch = 0.f, yaw = 0.f;
 float speed = 5.f, mouseSpeed = 0.005;
+bool cameraPath = false;
 
 // Timing
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// Assets, from the pack when there is one
+
+const char* const kAssetPackPath = "assets.pack";
+const char* const kTextureCachePath = "cache/textures"; // decoded images, compressed like the pack
+AssetPack assets;
+UploadRing uploadRing;   // texels decoded or read by the workers, uploaded from there
+TextureManager textures; // read through assets
+const uint32_t kUploadSlots = 8;
+const size_t kUploadSlotBytes = 4 << 20; // a 1024x1024 RGBA8 image
+
 // Meshes
 
 GLuint planeVAO;
 
-unsigned int majoraTexture;
+TextureManager::Handle majoraTexture;
 
-std::vector<glm::vec3> majoraVertices;
-std::vector<glm::vec2> majoraUvs;
-std::vector<glm::vec3> majoraNormals;
+// Floor and mask textures as layers of one texture array of the pack, bound once
+TextureArrays textureArrays;
+TextureArrays::Layer floorLayer, majoraLayer;
 
-int main(void)
+MeshLoader meshLoader;
+size_t uploadBudget = 4 << 20; // bytes per frame
+
+std::string majoraPath = "assets/majora.obj";
+std::shared_ptr<MeshLoader::Entry> majoraMesh;
+VertexLayout majoraLayout = VertexLayout::Interleaved;
+std::vector<DrawRange> majoraRanges;
+float majoraUvDensity = 0.f; // uv per model unit, for texture streaming
+
+const float kFloorUvPerUnit = 0.5f; // 25 repeats over 50 units
+bool virtualFloor = false;          // floor drawn through a virtual texture
+
+// Frame times, split by whether a mesh or texture was loading
+
+struct FrameTimes
 {
+	unsigned frames = 0;
+	double total = 0.0;
+	float worst = 0.f;
+
+	void add(float seconds)
+	{
+		frames++;
+		total += seconds;
+		worst = std::max(worst, seconds);
+	}
+};
+
+static void printFrameTimes(const char* when, const FrameTimes& times);
+
+int main(int argc, char** argv)
+{
+	// --layout=split|interleaved|quantized picks the vertex layout of the meshes (L cycles through them)
+	// --camera-path replaces the controls by a fixed flight around the mask, to compare culling stats
+	// --benchmark-load=file.obj compares OBJ and PLY parsing of the same mesh, then exits
+	// --mesh=file.obj|ply draws another mesh in place of the mask
+	// --upload-budget=KB bounds the mesh bytes, and the texture levels streamed, uploaded per frame
+	// --cook-pack packs assets/ and shaders/ into assets.pack, then exits
+	// --no-pack reads loose files even when assets.pack exists
+	// --no-texture-cache decodes images every run rather than caching them cooked
+	// --virtual-texture draws the floor through a virtual texture, its tiles read from the pack
+	bool usePack = true;
+	bool textureCache = true;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--benchmark-load=", 17) == 0)
+			return benchmarkMeshLoading(argv[i] + 17);
+		if (strcmp(argv[i], "--cook-pack") == 0)
+			return cookAssetPack();
+
+		if (strcmp(argv[i], "--layout=split") == 0)
+			majoraLayout = VertexLayout::Split;
+		else if (strcmp(argv[i], "--layout=interleaved") == 0)
+			majoraLayout = VertexLayout::Interleaved;
+		else if (strcmp(argv[i], "--layout=quantized") == 0)
+			majoraLayout = VertexLayout::Quantized;
+		else if (strcmp(argv[i], "--camera-path") == 0)
+			cameraPath = true;
+		else if (strncmp(argv[i], "--mesh=", 7) == 0)
+			majoraPath = argv[i] + 7;
+		else if (strncmp(argv[i], "--upload-budget=", 16) == 0)
+			uploadBudget = std::max(1, atoi(argv[i] + 16)) * (size_t)1024;
+		else if (strcmp(argv[i], "--no-pack") == 0)
+			usePack = false;
+		else if (strcmp(argv[i], "--no-texture-cache") == 0)
+			textureCache = false;
+		else if (strcmp(argv[i], "--virtual-texture") == 0)
+			virtualFloor = true;
+	}
+
+	// One mapping for every asset; compressed entries are all decompressed
+	// up front, in parallel
+	if (usePack && std::filesystem::exists(kAssetPackPath) && assets.open(kAssetPackPath))
+	{
+		Timer timer;
+		assets.preload();
+		printf("Mapped asset pack %s (%zu entries) in %.2f ms\n", kAssetPackPath, assets.entryCount(), timer.elapsed() * 1000.f);
+		meshLoader.setPack(&assets);
+	}
+	textures.setPack(&assets); // loose files when there is no pack
+	if (textureCache)
+		textures.setCache(kTextureCachePath, TextureCompression::S3TC);
+
+	// Parsing starts right away on the workers, the render loop uploads the
+	// mesh once ready and draws nothing in its place until then
+	majoraMesh = meshLoader.load(majoraPath, majoraLayout);
+
 	if (!glfwInit())
 		exit(EXIT_FAILURE);
 
@@ -158,14 +287,19 @@ int main(void)
 
 	glEnable(GL_DEPTH_TEST);
 
+	if (uploadRing.create(kUploadSlots, kUploadSlotBytes))
+		textures.setUploadRing(&uploadRing);
+	else
+		printf("No persistent mapped upload ring, textures are uploaded from client memory\n");
+
 	// Shader
 
-	const auto vertex = MakeShader(GL_VERTEX_SHADER, "shaders/shader.vert");
-	const auto fragment = MakeShader(GL_FRAGMENT_SHADER, "shaders/shader.frag");
+	const auto vertex = MakeShader(GL_VERTEX_SHADER, assets.read("shaders/shader.vert"));
+	const auto fragment = MakeShader(GL_FRAGMENT_SHADER, assets.read("shaders/shader.frag"));
 	const auto program = AttachAndLink({ vertex, fragment });
 
-	const auto vertexQuad = MakeShader(GL_VERTEX_SHADER, "shaders/shaderQuad.vert");
-	const auto fragmentQuad = MakeShader(GL_FRAGMENT_SHADER, "shaders/shaderQuad.frag");
+	const auto vertexQuad = MakeShader(GL_VERTEX_SHADER, assets.read("shaders/shaderQuad.vert"));
+	const auto fragmentQuad = MakeShader(GL_FRAGMENT_SHADER, assets.read("shaders/shaderQuad.frag"));
 	const auto programQuad = AttachAndLink({ vertexQuad, fragmentQuad });
 
 	// Plane
@@ -193,7 +327,9 @@ int main(void)
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	glBindVertexArray(0);
 
-	unsigned int woodTexture = loadTexture("assets/grass.png");
+	// Decoded on the workers while the rest is set up, uploaded by the render loop
+	TextureManager::Handle woodTexture = textures.load("assets/grass.png");
+	majoraTexture = textures.load("assets/majora.png");
 
 	// Configure depth map FBO
 
@@ -206,7 +342,7 @@ int main(void)
 	unsigned int depthMap;
 	glGenTextures(1, &depthMap);
 	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, SHADOW_WIDTH, SHADOW_HEIGHT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -224,15 +360,48 @@ int main(void)
 
 	// Build and compile shaders
 
-	Shader shader("shaders/shadow_mapping.vert", "shaders/shadow_mapping.frag");
-	Shader simpleDepthShader("shaders/shadow_mapping_depth.vert", "shaders/shadow_mapping_depth.frag");
-	Shader debugDepthQuad("shaders/debug_quad.vert", "shaders/debug_quad_depth.frag");
+	Shader shader = loadShader("shaders/shadow_mapping.vert", "shaders/shadow_mapping.frag");
+	Shader simpleDepthShader = loadShader("shaders/shadow_mapping_depth.vert", "shaders/shadow_mapping_depth.frag");
+	Shader debugDepthQuad = loadShader("shaders/debug_quad.vert", "shaders/debug_quad_depth.frag");
+	Shader feedbackShader = loadShader("shaders/shadow_mapping.vert", "shaders/virtual_feedback.frag");
+
+	// The floor texture cooked in the pack, in tiles of a virtual texture
+	VirtualTexture virtualTexture;
+	if (virtualFloor)
+	{
+		TextureView floorView;
+		TextureFileHeader floorHeader;
+		int frameWidth, frameHeight;
+		glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
+		const ByteSpan cooked = assets.find("assets/grass.png.tex");
+		if (cooked.empty() || !viewTextureFile(cooked.data, cooked.size, floorView, floorHeader)
+			|| !virtualTexture.create(floorView, 8, frameWidth, frameHeight, 8))
+		{
+			printf("Virtual texturing needs the floor texture cooked in %s (--cook-pack)\n", kAssetPackPath);
+			virtualFloor = false;
+		}
+	}
+
+	// Materials sharing a texture array of the pack, drawn without binding their textures
+	if (assets.isOpen() && textureArrays.load(assets) > 0)
+	{
+		floorLayer = textureArrays.find(assets, "assets/grass.png");
+		majoraLayer = textureArrays.find(assets, "assets/majora.png");
+		if (floorLayer.texture != 0 && floorLayer.texture == majoraLayer.texture)
+			glBindTextureUnit(4, floorLayer.texture);
+		else
+			floorLayer = majoraLayer = TextureArrays::Layer();
+	}
 
 	// Shader configuration
 
 	shader.use();
 	shader.setInt("diffuseTexture", 0);
 	shader.setInt("shadowMap", 1);
+	shader.setInt("virtualCache", 2);
+	shader.setInt("virtualIndirection", 3);
+	shader.setInt("virtualTail", 5);
+	shader.setInt("diffuseArray", 4);
 	debugDepthQuad.use();
 	debugDepthQuad.setInt("depthMap", 0);
 
@@ -247,11 +416,20 @@ int main(void)
 
 	glm::mat4 view, projection;
 
-	majoraTexture = loadTexture("assets/majora.png");
-
-	loadOBJ("assets/majora.obj", majoraVertices, majoraUvs, majoraNormals);
-
 	float rotate = 0.f;
+	unsigned frames = 0;
+	FrameTimes loadingTimes, loadedTimes;
+
+	// The shadow map may use coarser levels of detail than the screen
+	ScenePass shadowPass;
+	shadowPass.name = "shadow";
+	shadowPass.pixelsPerUnit = SHADOW_WIDTH / 20.f;
+	shadowPass.maxLodPixels = 4.f;
+	ScenePass cameraPass;
+	cameraPass.name = "camera";
+	cameraPass.eye = &position;
+	ScenePass feedbackPass = cameraPass;
+	feedbackPass.name = "feedback";
 
 	while (!glfwWindowShouldClose(window))
 	{
@@ -261,7 +439,19 @@ int main(void)
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		processCameraInput(window, deltaTime);
+		Timer frameTimer;
+		const bool loading = meshLoader.busy() || textures.busy();
+		meshLoader.update(uploadBudget);
+		uploadRing.update();
+		textures.update(uploadBudget);
+		if (virtualFloor)
+			virtualTexture.update(uploadBudget);
+
+		if (cameraPath)
+			followCameraPath(frames / 60.f);
+		else
+			processCameraInput(window, deltaTime);
+		frames++;
 
 		glClearColor(124.f / 255.f, 173.f / 255.f, 206.f / 255.f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -279,18 +469,19 @@ int main(void)
 		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
 		glClear(GL_DEPTH_BUFFER_BIT);
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodTexture);
-		renderScene(simpleDepthShader, rotate);
+		glBindTexture(GL_TEXTURE_2D, woodTexture->name);
+		shadowPass.viewProjection = lightSpaceMatrix;
+		renderScene(simpleDepthShader, rotate, shadowPass);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+		// In framebuffer pixels, which differ from window ones on HiDPI screens
+		int frameWidth, frameHeight;
+		glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
+		glViewport(0, 0, frameWidth, frameHeight);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		shader.use();
 
-		int frameWidth, frameHeight;
-		glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
-
 		view = glm::rotate(pitch, glm::vec3(1.f, 0.f, 0.f)) * glm::rotate(yaw, glm::vec3(0.f, 1.f, 0.f)) * glm::translate(-position);
 		projection = glm::perspective(glm::radians(45.f), (float)frameWidth / (float)frameHeight, 0.1f, 100.f);
 
@@ -305,11 +496,35 @@ int main(void)
 		rotate += 0.01f;
 		if (rotate >= 360.f) rotate -= 360.f;
 
+		cameraPass.viewProjection = projection * view;
+		cameraPass.pixelsPerUnit = frameHeight * 0.5f * projection[1][1];
+		if (virtualFloor)
+		{
+			// Tiles the camera sees, drawn small and read back a few frames later
+			feedbackPass.viewProjection = cameraPass.viewProjection;
+			feedbackPass.pixelsPerUnit = cameraPass.pixelsPerUnit;
+			feedbackShader.use();
+			feedbackShader.setMat4("projection", projection);
+			feedbackShader.setMat4("view", view);
+			virtualTexture.setFrameSize(frameWidth, frameHeight);
+			virtualTexture.setFeedbackUniforms(feedbackShader);
+			virtualTexture.beginFeedback();
+			renderScene(feedbackShader, rotate, feedbackPass);
+			virtualTexture.endFeedback();
+			shader.use();
+			virtualTexture.setUniforms(shader, 2, 3, 5);
+		}
+		else if (floorLayer.texture == 0)
+		{
+			const glm::vec3 floorClosest(glm::clamp(position.x, -25.f, 25.f), -0.5f, glm::clamp(position.z, -25.f, 25.f));
+			textures.request(woodTexture, kFloorUvPerUnit * std::max(glm::length(position - floorClosest), 0.1f) / cameraPass.pixelsPerUnit);
+		}
+
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodTexture);
+		glBindTexture(GL_TEXTURE_2D, woodTexture->name);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, depthMap);
-		renderScene(shader, rotate);
+		renderScene(shader, rotate, cameraPass);
 
 		debugDepthQuad.use();
 		debugDepthQuad.setFloat("near_plane", near_plane);
@@ -319,49 +534,42 @@ int main(void)
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+		(loading ? loadingTimes : loadedTimes).add(frameTimer.elapsed());
 	}
 	glDeleteVertexArrays(1, &planeVAO);
 	glDeleteBuffers(1, &planeVBO);
+	destroyMesh(majoraMesh->gpu);
+	textures.printResident();
+	uploadRing.printStats();
+	if (virtualFloor)
+		virtualTexture.printStats();
+	virtualTexture.destroy();
+	textureArrays.destroy();
+	woodTexture.reset();
+	majoraTexture.reset();
+	textures.wait(); // workers may be filling slots
+	uploadRing.destroy();
+	printPassStats(cameraPass, frames);
+	printPassStats(shadowPass, frames);
+	printFrameTimes("while loading", loadingTimes);
+	printFrameTimes("once loaded", loadedTimes);
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	exit(EXIT_SUCCESS);
 }
 
-unsigned int loadTexture(char const* path)
+Shader loadShader(const char* vertexName, const char* fragmentName)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
+	ByteSpan vertex = assets.read(vertexName), fragment = assets.read(fragmentName);
+	for (ByteSpan* source : { &vertex, &fragment })
 	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+		if (source->empty())
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+			*source = { "", 0 };
+		}
 	}
-
-	return textureID;
+	return Shader(vertex.data, vertex.size, fragment.data, fragment.size);
 }
 
 static void processCameraInput(GLFWwindow* window, float deltaTime)
@@ -404,17 +612,178 @@ static void processCameraInput(GLFWwindow* window, float deltaTime)
 		position += glm::normalize(velocity) * speed * deltaTime;
 }
 
-void renderScene(const Shader& shader, float rotate)
+static void followCameraPath(float time)
+{
+	// Orbit around the mask, coming close enough for parts of it to leave the screen
+	const glm::vec3 target(0.f, 1.5f, 0.f);
+	const float angle = time * 0.5f;
+	const float distance = 4.f + 2.5f * std::sin(time * 0.3f);
+	position = target + glm::vec3(distance * std::sin(angle), 1.5f * std::sin(time * 0.2f), distance * std::cos(angle));
+
+	const glm::vec3 forward = glm::normalize(target - position);
+	yaw = std::atan2(forward.x, -forward.z);
+	pitch = -std::asin(forward.y);
+}
+
+static int benchmarkMeshLoading(const char* objPath)
+{
+	// Same mesh as binary and ASCII PLY next to the OBJ, then every format
+	// parsed once more with a warm file cache
+	Mesh mesh;
+	if (!loadOBJ(objPath, mesh))
+		return EXIT_FAILURE;
+	const std::string binaryPath = std::string(objPath) + ".binary.ply";
+	const std::string asciiPath = std::string(objPath) + ".ascii.ply";
+	if (!writePLY(binaryPath.c_str(), mesh, true) || !writePLY(asciiPath.c_str(), mesh, false))
+	{
+		std::cerr << "Could not write the PLY copies of " << objPath << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const char* names[] = { "OBJ", "binary PLY", "ASCII PLY" };
+	const std::string paths[] = { objPath, binaryPath, asciiPath };
+	for (int i = 0; i < 3; i++)
+	{
+		Timer timer;
+		const bool ok = i == 0 ? loadOBJ(paths[i].c_str(), mesh) : loadPLY(paths[i].c_str(), mesh);
+		const float seconds = timer.elapsed();
+		if (!ok)
+			return EXIT_FAILURE;
+		printf("%-10s %8.3f s  %6.1f M triangles/s\n", names[i], seconds, mesh.triangleCount() / (seconds * 1e6f));
+	}
+	return EXIT_SUCCESS;
+}
+
+static int cookAssetPack()
+{
+	// Every file of assets/ and shaders/ as is, but meshes, which go in
+	// cooked: their binary mesh file, encoded (see meshcodec.h), so that
+	// loading them is a mapping away. Images are cooked too, with their mips
+	// and block compressed, and those of the same size class and format also
+	// go in texture arrays, "texture-arrays/<n>.tex" (see TextureArrays.h).
+	Timer timer;
+	std::vector<PackSource> sources;
+	std::vector<std::string> cookedTextures;
+	for (const char* directory : { "assets", "shaders" })
+	{
+		std::vector<std::string> files;
+		std::error_code error;
+		for (const auto& file : std::filesystem::directory_iterator(directory, error))
+			if (file.is_regular_file())
+				files.push_back(std::string(directory) + "/" + file.path().filename().string());
+		std::sort(files.begin(), files.end());
+
+		for (const std::string& file : files)
+		{
+			const std::string extension = std::filesystem::path(file).extension().string();
+			if (extension == ".mesh" || extension == ".tex" || extension == ".tmp")
+				continue;
+			if (extension == ".obj" || extension == ".ply")
+			{
+				MeshAsset mesh;
+				SourceInfo source;
+				const std::string encoded = file + ".encoded.mesh";
+				if (!loadMesh(file.c_str(), mesh) || !getSourceInfo(file.c_str(), source, true)
+					|| !writeMeshFile(encoded.c_str(), mesh.view, source, true))
+					return EXIT_FAILURE;
+				sources.push_back({ file + ".mesh", encoded });
+			}
+			else if (extension == ".png" || extension == ".bmp")
+			{
+				SourceInfo source;
+				if (!getSourceInfo(file.c_str(), source, true) || !cookTexture(file.c_str(), (file + ".tex").c_str(), TextureCompression::S3TC, source))
+					return EXIT_FAILURE;
+				sources.push_back({ file + ".tex", file + ".tex" });
+				cookedTextures.push_back(file + ".tex");
+			}
+			else
+				sources.push_back({ file, file });
+		}
+	}
+
+	std::vector<MappedFile> cooked(cookedTextures.size());
+	std::map<uint64_t, std::vector<TextureView>> classes;
+	std::map<uint64_t, std::vector<uint64_t>> classHashes;
+	for (size_t i = 0; i < cooked.size(); i++)
+	{
+		TextureView view;
+		TextureFileHeader header;
+		if (!mapTextureFile(cookedTextures[i].c_str(), cooked[i], view, header))
+			return EXIT_FAILURE;
+		classes[textureArrayClass(view)].push_back(view);
+		classHashes[textureArrayClass(view)].push_back(header.sourceHash);
+	}
+	size_t arrayCount = 0;
+	for (const auto& textureClass : classes)
+	{
+		if (textureClass.second.size() < 2)
+			continue;
+		const std::string path = "assets/texture-array-" + std::to_string(arrayCount) + ".tex";
+		if (!writeTextureArray(path.c_str(), textureClass.second, classHashes[textureClass.first]))
+			return EXIT_FAILURE;
+		sources.push_back({ "texture-arrays/" + std::to_string(arrayCount++) + ".tex", path });
+		printf("Texture array of %zu %ux%u %s textures\n", textureClass.second.size(),
+			textureClass.second[0].width, textureClass.second[0].height, textureFormatName(textureClass.second[0].format));
+	}
+
+	if (!writeAssetPack(kAssetPackPath, sources, true))
+	{
+		std::cerr << "Could not write " << kAssetPackPath << std::endl;
+		return EXIT_FAILURE;
+	}
+	printf("Packed %zu assets into %s (%.1f MB) in %.2f s\n", sources.size(), kAssetPackPath,
+		std::filesystem::file_size(kAssetPackPath) / (1024.0 * 1024.0), timer.elapsed());
+	return EXIT_SUCCESS;
+}
+
+static void printFrameTimes(const char* when, const FrameTimes& times)
+{
+	if (times.frames == 0)
+		return;
+	printf("Frame time %s: %u frames, %.2f ms average, %.2f ms worst\n",
+		when, times.frames, times.total * 1000.0 / times.frames, times.worst * 1000.f);
+}
+
+static void printPassStats(const ScenePass& pass, unsigned frames)
+{
+	if (frames == 0)
+		return;
+	printf("Levels of detail, %s pass over %u frames:", pass.name, frames);
+	for (size_t i = 0; i < kMaxMeshLods; i++)
+		if (pass.lodDraws[i])
+			printf(" %zu: %.1f%%", i, 100.0 * pass.lodDraws[i] / frames);
+	printf("\n");
+
+	const MeshletCullStats& stats = pass.cullStats;
+	if (stats.triangles == 0)
+		return;
+	const double total = (double)stats.triangles;
+	printf("Meshlet culling, %s pass: %.1f%% of full resolution triangles culled (frustum %.1f%%, backface %.1f%%), %.1f draws per frame\n",
+		pass.name, 100.0 * (stats.frustumCulled + stats.backfaceCulled) / total,
+		100.0 * stats.frustumCulled / total, 100.0 * stats.backfaceCulled / total, (double)stats.draws / pass.lodDraws[0]);
+}
+
+void renderScene(const Shader& shader, float rotate, ScenePass& pass)
 {
 	// Floor
 
 	glm::mat4 model = glm::mat4(1.0f);
 	shader.setMat4("model", model);
+	shader.setVec3("positionOffset", glm::vec3(0.f));
+	shader.setVec3("positionScale", glm::vec3(1.f));
+	shader.setBool("octNormals", false);
+	shader.setBool("virtualTexture", virtualFloor);
+	TextureArrays::setUniforms(shader, floorLayer);
 	glBindVertexArray(planeVAO);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
+	shader.setBool("virtualTexture", false);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, majoraTexture);
+	TextureArrays::setUniforms(shader, majoraLayer);
+	if (majoraLayer.texture == 0)
+	{
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, majoraTexture->name);
+	}
 
 	// Model
 
@@ -423,7 +792,7 @@ void renderScene(const Shader& shader, float rotate)
 	model = glm::scale(model, glm::vec3(0.5f));
 	model = glm::rotate(model, rotate, glm::vec3(0.f, 1.f, 0.f));
 	shader.setMat4("model", model);
-	renderMajoraMask();
+	renderMajoraMask(shader, model, pass);
 }
 
 unsigned int cubeVAO = 0;
@@ -457,54 +826,74 @@ void renderCube()
 	glBindVertexArray(0);
 }
 
-GLuint majoraVAO = 0;
-GLuint majoraVBO = 0;
-GLuint majoraUVsBuffer = 0;
-GLuint majoraNormalsBuffer = 0;
-
-void renderMajoraMask()
+void renderMajoraMask(const Shader& shader, const glm::mat4& model, ScenePass& pass)
 {
-	// initialize (if necessary)
-	if (majoraVAO == 0)
+	// Nothing stands in for the mask until the loader made it resident
+	if (!majoraMesh->resident())
+		return;
+
+	// re-upload after a layout change, straight from the mapped mesh cache when there is one
+	const MeshView& view = majoraMesh->asset.view;
+	GpuMesh& gpu = majoraMesh->gpu;
+	if (gpu.vao == 0)
 	{
-		glGenVertexArrays(1, &majoraVAO);
-
-		glGenBuffers(1, &majoraVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, majoraVBO);
-		if (!majoraVertices.empty())
-			glBufferData(GL_ARRAY_BUFFER, majoraVertices.size() * sizeof(glm::vec3), &majoraVertices[0], GL_STATIC_DRAW);
-
-		glGenBuffers(1, &majoraNormalsBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, majoraNormalsBuffer);
-		if (!majoraNormals.empty())
-			glBufferData(GL_ARRAY_BUFFER, majoraNormals.size() * sizeof(glm::vec3), &majoraNormals[0], GL_STATIC_DRAW);
-
-		glGenBuffers(1, &majoraUVsBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, majoraUVsBuffer);
-		if (!majoraUvs.empty())
-			glBufferData(GL_ARRAY_BUFFER, majoraUvs.size() * sizeof(glm::vec2), &majoraUvs[0], GL_STATIC_DRAW);
-
-		// link vertex attributes
-		glBindVertexArray(majoraVAO);
-
-		glBindBuffer(GL_ARRAY_BUFFER, majoraVAO);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-
-		glBindBuffer(GL_ARRAY_BUFFER, majoraNormalsBuffer);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-
-		glBindBuffer(GL_ARRAY_BUFFER, majoraUVsBuffer);
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		if (view.encoded() && majoraLayout != VertexLayout::Quantized)
+			decodeMeshAsset(majoraMesh->asset);
+		gpu = uploadMesh(view, majoraLayout);
+		std::cout << "Mask uploaded with " << layoutName(majoraLayout) << " layout (" << gpu.vertexBytes << " vertex bytes)" << std::endl;
 	}
-	glBindVertexArray(majoraVAO);
-	glDrawArrays(GL_TRIANGLES, 0, majoraVertices.size() * 3);
-	glBindVertexArray(0);
+	if (majoraUvDensity == 0.f)
+		majoraUvDensity = uvDensity(view);
+	if (majoraUvDensity == 0.f) // encoded: the texture is assumed to span the mask once
+		majoraUvDensity = 1.f / glm::length(view.bounds.max - view.bounds.min);
+	shader.setVec3("positionOffset", gpu.positionOffset);
+	shader.setVec3("positionScale", gpu.positionScale);
+	shader.setBool("octNormals", gpu.octNormals);
+
+	// Coarsest level of detail whose error stays under a few pixels, and
+	// texture levels for the closest point of the mask
+	const float scale = glm::length(glm::vec3(model[0]));
+	float pixelsPerUnit = pass.pixelsPerUnit * scale;
+	if (pass.eye)
+	{
+		const glm::vec3 center = glm::vec3(model * glm::vec4((view.bounds.min + view.bounds.max) * 0.5f, 1.f));
+		const float distance = glm::length(*pass.eye - center);
+		pixelsPerUnit /= std::max(distance, 0.1f);
+		const float closest = std::max(distance - glm::length(view.bounds.max - view.bounds.min) * 0.5f * scale, 0.1f);
+		if (majoraLayer.texture == 0)
+			textures.request(majoraTexture, majoraUvDensity * closest / (pass.pixelsPerUnit * scale));
+	}
+	size_t lod = 0;
+	if (view.lodCount > 1)
+		lod = selectLod(view.lods, view.lodCount, pixelsPerUnit, pass.maxLodPixels);
+	pass.lodDraws[lod]++;
+
+	// Meshlets of the full resolution level outside the frustum or, seen from
+	// the eye, facing away are not drawn. Shadow casters have no eye: their
+	// back faces cast shadows too
+	if (lod > 0 || view.meshletCount == 0)
+	{
+		if (view.lodCount == 0)
+			drawMesh(gpu);
+		else
+			drawMeshRanges(gpu, { { view.lods[lod].indexOffset, view.lods[lod].indexCount } });
+		return;
+	}
+	glm::vec3 modelEye;
+	if (pass.eye)
+		modelEye = glm::vec3(glm::inverse(model) * glm::vec4(*pass.eye, 1.f));
+	cullMeshlets(view.meshlets, view.meshletCount, pass.viewProjection * model, pass.eye ? &modelEye : nullptr, majoraRanges, pass.cullStats);
+	drawMeshRanges(gpu, majoraRanges);
+}
+
+static void toggleMeshLayout()
+{
+	if (!majoraMesh->resident())
+		return;
+	majoraLayout = majoraLayout == VertexLayout::Split ? VertexLayout::Interleaved
+		: majoraLayout == VertexLayout::Interleaved ? VertexLayout::Quantized
+		: VertexLayout::Split;
+	destroyMesh(majoraMesh->gpu);
 }
 
 unsigned int quadVAO = 0;
@@ -11,6 +11,26 @@ in VS_OUT {
 uniform sampler2D diffuseTexture;
 uniform sampler2D shadowMap;
 
+// Virtual texture standing in for diffuseTexture, see utils/VirtualTexture.h
+uniform bool virtualTexture = false;
+uniform sampler2D virtualCache;         // tiles with their border
+uniform usampler2D virtualIndirection;  // per tile of each level: slot x, slot y, level of the tile to sample
+uniform sampler2D virtualTail;          // levels from virtualMaxLevel down, mipmapped
+uniform vec2 virtualSize;               // texels of level 0
+uniform float virtualMaxLevel;
+uniform bool virtualRepeat;
+uniform float virtualTileSize;
+uniform float virtualTileBorder;
+uniform float virtualCacheSize;
+uniform float virtualLodBias;
+
+// Layer of a texture array standing in for diffuseTexture, see utils/TextureArrays.h
+uniform bool textureArray = false;
+uniform sampler2DArray diffuseArray;
+uniform float diffuseLayer;
+uniform vec2 diffuseUvScale;            // of the layer the texture fills, from its top left corner
+uniform bool diffuseRepeat;
+
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
@@ -50,9 +70,53 @@ float ShadowCalculation(vec4 fragPosLightSpace)
     return shadow;
 }
 
+vec3 VirtualColor(vec2 texCoords)
+{
+    // the level a mip-mapped texture would sample, then the tile it falls in
+    vec2 gradX = dFdx(texCoords);
+    vec2 gradY = dFdy(texCoords);
+    float footprint = max(length(gradX * virtualSize), length(gradY * virtualSize));
+    float lod = log2(max(footprint, 1e-6)) + virtualLodBias;
+    // no finer than a single tile: the mip tail, trilinear like a plain texture
+    if (lod >= virtualMaxLevel)
+        return textureGrad(virtualTail, texCoords, gradX, gradY).rgb;
+    float level = clamp(floor(lod), 0.0, virtualMaxLevel);
+    vec2 uv = virtualRepeat ? fract(texCoords) : clamp(texCoords, 0.0, 1.0);
+    vec2 levelSize = max(floor(virtualSize / exp2(level)), vec2(1.0));
+    vec2 tile = min(floor(uv * levelSize / virtualTileSize), ceil(levelSize / virtualTileSize) - 1.0);
+    uvec4 entry = texelFetch(virtualIndirection, ivec2(tile), int(level));
+    // sampled in the tile it points to: this one or an ancestor
+    levelSize = max(floor(virtualSize / exp2(float(entry.z))), vec2(1.0));
+    vec2 inTile = uv * levelSize / virtualTileSize;
+    inTile -= min(floor(inTile), ceil(levelSize / virtualTileSize) - 1.0);
+    vec2 cacheTexel = vec2(entry.xy) * (virtualTileSize + 2.0 * virtualTileBorder) + virtualTileBorder + inTile * virtualTileSize;
+    return textureLod(virtualCache, cacheTexel / virtualCacheSize, 0.0).rgb;
+}
+
+vec3 ArrayColor(vec2 texCoords)
+{
+    // wrapped by hand within the texture, with the derivatives of the unwrapped
+    // coordinates: the padding of the layer holds the texels across the seam
+    vec2 gradX = dFdx(texCoords) * diffuseUvScale;
+    vec2 gradY = dFdy(texCoords) * diffuseUvScale;
+    vec2 uv = fract(texCoords) * diffuseUvScale;
+    if (!diffuseRepeat)
+    {
+        // the array repeats: clamped textures stay half a texel of the
+        // coarser level sampled inside their edges
+        vec2 layerSize = vec2(textureSize(diffuseArray, 0).xy);
+        float footprint = max(length(gradX * layerSize), length(gradY * layerSize));
+        vec2 halfTexel = 0.5 * exp2(ceil(log2(max(footprint, 1.0)))) / layerSize;
+        uv = clamp(texCoords * diffuseUvScale, halfTexel, diffuseUvScale - halfTexel);
+    }
+    return textureGrad(diffuseArray, vec3(uv, diffuseLayer), gradX, gradY).rgb;
+}
+
 void main()
 {           
-    vec3 color = texture(diffuseTexture, fs_in.TexCoords).rgb;
+    vec3 color = virtualTexture ? VirtualColor(fs_in.TexCoords)
+        : textureArray ? ArrayColor(fs_in.TexCoords)
+        : texture(diffuseTexture, fs_in.TexCoords).rgb;
     vec3 normal = normalize(fs_in.Normal);
     vec3 lightColor = vec3(0.3);
     // ambient
@@ -0,0 +1,34 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec4 FragPosLightSpace;
+} fs_in;
+
+// Tile of the virtual texture each pixel needs, see utils/VirtualTexture.h:
+// x and y among the tiles of its level, the level, and alpha 1 (0 elsewhere)
+uniform bool virtualTexture = false;
+uniform vec2 virtualSize;
+uniform float virtualMaxLevel;
+uniform bool virtualRepeat;
+uniform float virtualTileSize;
+uniform float virtualLodBias; // drawn at a lower resolution than the frame
+
+void main()
+{
+    if (!virtualTexture)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+    vec2 texels = fs_in.TexCoords * virtualSize;
+    float footprint = max(length(dFdx(texels)), length(dFdy(texels)));
+    float level = clamp(floor(log2(max(footprint, 1e-6)) + virtualLodBias), 0.0, virtualMaxLevel);
+    vec2 uv = virtualRepeat ? fract(fs_in.TexCoords) : clamp(fs_in.TexCoords, 0.0, 1.0);
+    vec2 levelSize = max(floor(virtualSize / exp2(level)), vec2(1.0));
+    vec2 tile = min(floor(uv * levelSize / virtualTileSize), ceil(levelSize / virtualTileSize) - 1.0);
+    FragColor = vec4(tile, level, 255.0) / 255.0;
+}
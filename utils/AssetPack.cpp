@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <stdio.h>
+
+#include "AssetPack.h"
+#include "hash.h"
+#include "lz4.h"
+#include "ThreadPool.h"
+
+namespace {
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Zero marks empty slots
+inline uint64_t hashName(const char* name, size_t length)
+{
+	const uint64_t hash = hash64(name, length);
+	return hash ? hash : 1;
+}
+
+bool writePadding(FILE* file, uint64_t& offset, uint64_t alignment)
+{
+	static const char zeros[4096] = {};
+	for (uint64_t aligned = alignUp(offset, alignment); offset < aligned;)
+	{
+		const size_t count = (size_t)std::min<uint64_t>(sizeof(zeros), aligned - offset);
+		if (fwrite(zeros, 1, count, file) != count)
+			return false;
+		offset += count;
+	}
+	return true;
+}
+
+bool isValid(const PackHeader& header, size_t fileSize)
+{
+	if (fileSize < sizeof(PackHeader) || memcmp(header.magic, "GPAK", 4) != 0 || header.version != kPackVersion)
+		return false;
+	if (header.slotCount == 0 || (header.slotCount & (header.slotCount - 1)) != 0 || header.entryCount >= header.slotCount)
+		return false;
+	return header.slotsOffset <= fileSize && (uint64_t)header.slotCount * sizeof(PackEntry) <= fileSize - header.slotsOffset
+		&& header.namesOffset <= fileSize && header.namesSize <= fileSize - header.namesOffset;
+}
+
+}
+
+bool writeAssetPack(const char* path, const std::vector<PackSource>& sources, bool compress)
+{
+	std::vector<MappedFile> files(sources.size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		if (!files[i].open(sources[i].path.c_str()))
+		{
+			printf("Impossible to open %s\n", sources[i].path.c_str());
+			return false;
+		}
+	}
+
+	// Entries that do not shrink by a tenth are stored as is: images are
+	// compressed already, and stored entries are read straight from the mapping
+	std::vector<std::vector<char>> compressed(sources.size());
+	if (compress)
+	{
+		ThreadPool::shared().parallelFor(sources.size(), [&](size_t i)
+		{
+			const size_t size = lz4Compress(files[i].data(), files[i].size(), compressed[i]);
+			if (size > files[i].size() - files[i].size() / 10)
+				compressed[i] = std::vector<char>();
+		});
+	}
+
+	size_t slotCount = 16;
+	while (slotCount < sources.size() * 2 + 1)
+		slotCount *= 2;
+	std::vector<PackEntry> slots(slotCount, PackEntry());
+	std::string names;
+
+	PackHeader header = {};
+	memcpy(header.magic, "GPAK", 4);
+	header.version = kPackVersion;
+	header.entryCount = (uint32_t)sources.size();
+	header.slotCount = (uint32_t)slotCount;
+	header.slotsOffset = alignUp(sizeof(PackHeader), 16);
+	header.namesOffset = header.slotsOffset + slotCount * sizeof(PackEntry);
+
+	for (const PackSource& source : sources)
+		names += source.name;
+	header.namesSize = names.size();
+
+	// Entries follow in source order, placed before their slots are filled
+	uint64_t offset = header.namesOffset + header.namesSize;
+	uint32_t nameOffset = 0;
+	std::vector<size_t> order(sources.size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		PackEntry entry = {};
+		entry.nameHash = hashName(sources[i].name.data(), sources[i].name.size());
+		entry.offset = offset = alignUp(offset, kPackAlignment);
+		entry.rawSize = files[i].size();
+		entry.compression = compressed[i].empty() ? PackStored : PackLZ4;
+		entry.size = compressed[i].empty() ? files[i].size() : compressed[i].size();
+		entry.nameOffset = nameOffset;
+		entry.nameLength = (uint32_t)sources[i].name.size();
+		offset += entry.size;
+		nameOffset += entry.nameLength;
+
+		size_t slot = entry.nameHash & (slotCount - 1);
+		for (; slots[slot].nameHash != 0; slot = (slot + 1) & (slotCount - 1))
+		{
+			const PackEntry& other = slots[slot];
+			if (other.nameHash == entry.nameHash && other.nameLength == entry.nameLength
+				&& memcmp(names.data() + other.nameOffset, names.data() + entry.nameOffset, entry.nameLength) == 0)
+			{
+				printf("Asset %s is packed twice\n", sources[i].name.c_str());
+				return false;
+			}
+		}
+		slots[slot] = entry;
+		order[i] = slot;
+	}
+
+	// Write next to the destination and rename, like mesh caches
+	const std::string temporary = std::string(path) + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+
+	offset = 0;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	offset += sizeof(header);
+	ok = ok && writePadding(file, offset, 16)
+		&& fwrite(slots.data(), sizeof(PackEntry), slotCount, file) == slotCount
+		&& (names.empty() || fwrite(names.data(), 1, names.size(), file) == names.size());
+	offset = header.namesOffset + header.namesSize;
+	for (size_t i = 0; ok && i < sources.size(); i++)
+	{
+		const PackEntry& entry = slots[order[i]];
+		const char* data = compressed[i].empty() ? files[i].data() : compressed[i].data();
+		ok = writePadding(file, offset, kPackAlignment)
+			&& (entry.size == 0 || fwrite(data, 1, (size_t)entry.size, file) == entry.size);
+		offset += entry.size;
+	}
+	ok = fclose(file) == 0 && ok;
+
+	std::error_code error;
+	if (ok)
+		std::filesystem::rename(temporary, path, error);
+	if (!ok || error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+bool AssetPack::open(const char* path)
+{
+	if (!file.open(path))
+		return false;
+
+	PackHeader header;
+	if (file.size() >= sizeof(PackHeader))
+		memcpy(&header, file.data(), sizeof(header));
+	if (file.size() < sizeof(PackHeader) || !isValid(header, file.size()))
+	{
+		printf("Invalid asset pack %s\n", path);
+		file.close();
+		return false;
+	}
+
+	slots = (const PackEntry*)(file.data() + header.slotsOffset);
+	slotMask = header.slotCount - 1;
+	names = file.data() + header.namesOffset;
+	entries.clear();
+	bool valid = true;
+	for (uint32_t slot = 0; valid && slot < header.slotCount; slot++)
+	{
+		const PackEntry& entry = slots[slot];
+		if (entry.nameHash == 0)
+			continue;
+		// Bounded so that decompression never allocates more than the entry
+		// can hold
+		valid = entry.offset <= file.size() && entry.size <= file.size() - entry.offset
+			&& (uint64_t)entry.nameOffset + entry.nameLength <= header.namesSize
+			&& (entry.compression != PackLZ4 || entry.rawSize <= entry.size * kLz4MaxRatio);
+		entries.push_back(slot);
+	}
+	// isValid keeps entryCount below slotCount, so a matching count leaves the
+	// empty slot that lookups stop at
+	if (!valid || entries.size() != header.entryCount)
+	{
+		printf("Invalid asset pack %s\n", path);
+		slots = nullptr;
+		entries.clear();
+		file.close();
+		return false;
+	}
+
+	decompressed.assign(header.slotCount, std::vector<char>());
+	decompressOnce.reset(new std::once_flag[header.slotCount]);
+	return true;
+}
+
+void AssetPack::preload()
+{
+	std::vector<uint32_t> compressed;
+	for (uint32_t slot : entries)
+		if (slots[slot].compression != PackStored)
+			compressed.push_back(slot);
+	ThreadPool::shared().parallelFor(compressed.size(), [&](size_t i) { get(compressed[i]); });
+}
+
+ptrdiff_t AssetPack::lookup(const std::string& name) const
+{
+	if (!slots)
+		return -1;
+	const uint64_t hash = hashName(name.data(), name.size());
+	for (size_t slot = hash & slotMask; slots[slot].nameHash != 0; slot = (slot + 1) & slotMask)
+	{
+		const PackEntry& entry = slots[slot];
+		if (entry.nameHash == hash && entry.nameLength == name.size() && memcmp(names + entry.nameOffset, name.data(), name.size()) == 0)
+			return (ptrdiff_t)slot;
+	}
+	return -1;
+}
+
+ByteSpan AssetPack::get(size_t slot)
+{
+	const PackEntry& entry = slots[slot];
+	if (entry.compression == PackStored)
+		return { file.data() + entry.offset, (size_t)entry.size };
+
+	std::call_once(decompressOnce[slot], [&]()
+	{
+		std::vector<char> bytes((size_t)entry.rawSize);
+		if (entry.compression == PackLZ4 && lz4Decompress(file.data() + entry.offset, (size_t)entry.size, bytes.data(), bytes.size()))
+			decompressed[slot].swap(bytes);
+		else
+			printf("Corrupt asset %.*s in pack\n", (int)entry.nameLength, names + entry.nameOffset);
+	});
+	const std::vector<char>& bytes = decompressed[slot];
+	if (bytes.size() != entry.rawSize)
+		return ByteSpan();
+	// Empty entries still get a non-null pointer
+	return { bytes.empty() ? file.data() + entry.offset : bytes.data(), bytes.size() };
+}
+
+ByteSpan AssetPack::find(const std::string& name)
+{
+	const ptrdiff_t slot = lookup(name);
+	return slot < 0 ? ByteSpan() : get((size_t)slot);
+}
+
+ByteSpan AssetPack::read(const std::string& name)
+{
+	const ptrdiff_t slot = lookup(name);
+	if (slot >= 0)
+		return get((size_t)slot);
+
+	std::lock_guard<std::mutex> lock(looseMutex);
+	std::unique_ptr<MappedFile>& loose = looseFiles[name];
+	if (!loose)
+	{
+		std::unique_ptr<MappedFile> mapped(new MappedFile());
+		if (!mapped->open(name.c_str()))
+		{
+			looseFiles.erase(name);
+			return ByteSpan();
+		}
+		loose = std::move(mapped);
+	}
+	return { loose->data(), loose->size() };
+}
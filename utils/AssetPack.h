@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Bytes of an asset, owned by whoever handed them out
+struct ByteSpan
+{
+	const char* data = nullptr;
+	size_t size = 0;
+
+	bool empty() const { return data == nullptr; }
+};
+
+// Pack file, little-endian: header, table of contents, then every entry
+// starting on a 64 KiB boundary. The table of contents is an open-addressing
+// hash table keyed by hash64 of the entry names, so finding an entry costs a
+// probe or two whatever the number of entries.
+struct PackHeader
+{
+	char magic[4];        // "GPAK"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t slotCount;   // power of two, at least twice entryCount
+	uint64_t slotsOffset; // PackEntry per slot, empty ones have a zero nameHash
+	uint64_t namesOffset; // entry names, not null-terminated
+	uint64_t namesSize;
+};
+
+struct PackEntry
+{
+	uint64_t nameHash;
+	uint64_t offset;
+	uint64_t size;        // stored bytes
+	uint64_t rawSize;     // bytes once decompressed
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t compression; // PackCompression
+	uint32_t reserved;
+};
+static_assert(sizeof(PackEntry) == 48, "pack entries are stored as is");
+
+enum PackCompression : uint32_t
+{
+	PackStored = 0,
+	PackLZ4 = 1
+};
+
+const uint32_t kPackVersion = 1;
+const uint64_t kPackAlignment = 64 << 10;
+
+// File to put in a pack under name
+struct PackSource
+{
+	std::string name;
+	std::string path;
+};
+
+// Writes a pack of sources. With compress, entries are LZ4 compressed (in
+// parallel) when that saves at least a tenth of their size.
+bool writeAssetPack(const char* path, const std::vector<PackSource>& sources, bool compress);
+
+// Assets read from a pack mapped once. Stored entries are handed out straight
+// from the mapping, compressed ones are decompressed once (on first use or
+// by preload) and kept for the lifetime of the pack.
+class AssetPack
+{
+public:
+	AssetPack() = default;
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	bool open(const char* path);
+	bool isOpen() const { return file.isOpen(); }
+	size_t entryCount() const { return entries.size(); }
+
+	// Decompresses every compressed entry on the shared thread pool
+	void preload();
+
+	// Entry of the pack, empty when there is none. Thread-safe.
+	ByteSpan find(const std::string& name);
+
+	// Entry of the pack, or else the loose file of that name, mapped on
+	// first use. Thread-safe.
+	ByteSpan read(const std::string& name);
+
+private:
+	// Slot of the entry, or -1
+	ptrdiff_t lookup(const std::string& name) const;
+	ByteSpan get(size_t slot);
+
+	MappedFile file;
+	const PackEntry* slots = nullptr;
+	size_t slotMask = 0;
+	const char* names = nullptr;
+
+	// Occupied slots, and the decompressed bytes of every slot
+	std::vector<uint32_t> entries;
+	std::vector<std::vector<char>> decompressed;
+	std::unique_ptr<std::once_flag[]> decompressOnce;
+
+	std::mutex looseMutex;
+	std::unordered_map<std::string, std::unique_ptr<MappedFile>> looseFiles;
+};
@@ -0,0 +1,162 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char* path)
+{
+	open(path);
+}
+
+MappedFile::~MappedFile()
+{
+	release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	steal(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		steal(other);
+	}
+	return *this;
+}
+
+void MappedFile::steal(MappedFile& other)
+{
+	ptr = other.ptr;
+	length = other.length;
+	opened = other.opened;
+#ifdef _WIN32
+	file = other.file;
+	mapping = other.mapping;
+	other.file = nullptr;
+	other.mapping = nullptr;
+#else
+	fd = other.fd;
+	other.fd = -1;
+#endif
+	other.ptr = nullptr;
+	other.length = 0;
+	other.opened = false;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+	release();
+
+	HANDLE h = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(h, &fileSize))
+	{
+		CloseHandle(h);
+		return false;
+	}
+
+	file = h;
+	length = (size_t)fileSize.QuadPart;
+	opened = true;
+
+	// Empty files cannot be mapped, but they are still valid (and empty) inputs
+	if (length == 0)
+		return true;
+
+	mapping = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		ptr = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!ptr)
+	{
+		release();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::release()
+{
+	if (ptr)
+		UnmapViewOfFile(ptr);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	ptr = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	length = 0;
+	opened = false;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	release();
+
+	int f = ::open(path, O_RDONLY);
+	if (f < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(f, &st) != 0)
+	{
+		::close(f);
+		return false;
+	}
+
+	fd = f;
+	length = (size_t)st.st_size;
+	opened = true;
+
+	if (length == 0)
+		return true;
+
+	void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED)
+	{
+		release();
+		return false;
+	}
+	madvise(p, length, MADV_SEQUENTIAL);
+	ptr = (const char*)p;
+	return true;
+}
+
+void MappedFile::release()
+{
+	if (ptr)
+		munmap((void*)ptr, length);
+	if (fd >= 0)
+		::close(fd);
+	ptr = nullptr;
+	fd = -1;
+	length = 0;
+	opened = false;
+}
+
+#endif
+
+void MappedFile::close()
+{
+	release();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+// The mapping stays valid until close() or destruction.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const char* path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool open(const char* path);
+	void close();
+
+	bool isOpen() const { return opened; }
+	const char* data() const { return ptr; }
+	size_t size() const { return length; }
+
+private:
+	void release();
+	void steal(MappedFile& other);
+
+	const char* ptr = nullptr;
+	size_t length = 0;
+	bool opened = false;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include "MeshLoader.h"
+
+MeshLoader::MeshLoader(ThreadPool& pool)
+	: pool(pool)
+{
+}
+
+MeshLoader::~MeshLoader()
+{
+	for (std::future<void>& job : jobs)
+		job.wait();
+}
+
+std::shared_ptr<MeshLoader::Entry> MeshLoader::load(const std::string& path, VertexLayout layout)
+{
+	auto entry = std::make_shared<Entry>();
+	entry->path = path;
+	entry->layout = layout;
+	pending++;
+
+	jobs.push_back(pool.submit([this, entry]()
+	{
+		bool packed = false;
+		if (pack)
+		{
+			const ByteSpan cooked = pack->find(entry->path + ".mesh");
+			MeshFileHeader header;
+			packed = !cooked.empty() && viewMeshFile(cooked.data, cooked.size, entry->asset.view, header);
+		}
+		// Encoded meshes are decoded while uploading in the quantized layout,
+		// and right away otherwise
+		const MeshView& view = entry->asset.view;
+		if ((!packed && !loadMesh(entry->path.c_str(), entry->asset))
+			|| (view.encoded() && entry->layout != VertexLayout::Quantized && !decodeMeshAsset(entry->asset)))
+		{
+			entry->state = State::Failed;
+			pending--;
+			return;
+		}
+		entry->data = prepareMesh(entry->asset.view, entry->layout);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		entry->state = State::Uploading;
+		ready.push_back(entry);
+	}));
+	return entry;
+}
+
+size_t MeshLoader::update(size_t byteBudget)
+{
+	size_t uploaded = 0;
+	while (uploaded < byteBudget)
+	{
+		if (!uploading)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (ready.empty())
+				break;
+			uploading = ready.front();
+			ready.erase(ready.begin());
+
+			// Buffers are allocated now and filled over the next frames
+			uploading->gpu = createMesh(uploading->data, false);
+			uploadBuffer = 0;
+			uploadOffset = 0;
+		}
+
+		// Buffers in order: vertex buffers by binding, then indices
+		Entry& entry = *uploading;
+		const GpuMeshData::Buffer& source = uploadBuffer < 3 ? entry.data.vertexBuffers[uploadBuffer] : entry.data.indices;
+		const GLuint target = uploadBuffer < 3 ? entry.gpu.vertexBuffers[uploadBuffer] : entry.gpu.indexBuffer;
+		size_t size = std::min(source.size - uploadOffset, byteBudget - uploaded);
+		if (source.encoded && size > 0)
+		{
+			// Decoded straight into the mapped buffer, whole elements at a time
+			bool decoded = uploadOffset > 0 || beginDecoding(entry.data, uploadBuffer, decoder);
+			const size_t elementSize = decoder.elementSize();
+			size = std::max(size / elementSize, size_t(1)) * elementSize;
+			if (decoded)
+			{
+				void* mapped = glMapNamedBufferRange(target, uploadOffset, size,
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+				decoded = mapped && decoder.decode(mapped, size / elementSize);
+				glUnmapNamedBuffer(target);
+			}
+			if (!decoded || (uploadOffset + size == source.size && !decoder.finished()))
+			{
+				printf("Could not decode mesh %s\n", entry.path.c_str());
+				destroyMesh(entry.gpu);
+				entry.data = GpuMeshData();
+				entry.state = State::Failed;
+				uploading.reset();
+				pending--;
+				continue;
+			}
+		}
+		else if (size > 0)
+			glNamedBufferSubData(target, uploadOffset, size, (const char*)source.data + uploadOffset);
+		uploadOffset += size;
+		uploaded += size;
+
+		if (uploadOffset < source.size)
+			break;
+		uploadOffset = 0;
+		if (++uploadBuffer <= 3)
+			continue;
+
+		printf("Mesh %s resident (%.1f MB, %s layout)\n", entry.path.c_str(),
+			entry.data.totalBytes() / (1024.0 * 1024.0), layoutName(entry.layout));
+		entry.data = GpuMeshData();
+		entry.state = State::Resident;
+		uploading.reset();
+		pending--;
+	}
+	return uploaded;
+}
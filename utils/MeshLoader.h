@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AssetPack.h"
+#include "gpumesh.h"
+#include "meshcache.h"
+#include "ThreadPool.h"
+
+// Loads meshes in the background: worker threads read them through their
+// cache and prepare their buffers, then the GL thread uploads them a bounded
+// number of bytes per frame. Meshes can only be drawn once resident.
+class MeshLoader
+{
+public:
+	enum class State { Loading, Uploading, Resident, Failed };
+
+	struct Entry
+	{
+		std::string path;
+		VertexLayout layout = VertexLayout::Interleaved;
+		std::atomic<State> state{ State::Loading };
+		MeshAsset asset;  // written by the worker, read-only once Uploading
+		GpuMeshData data; // idem, released once Resident
+		GpuMesh gpu;      // valid once Resident
+
+		bool resident() const { return state == State::Resident; }
+	};
+
+	explicit MeshLoader(ThreadPool& pool = ThreadPool::shared());
+	~MeshLoader();
+
+	MeshLoader(const MeshLoader&) = delete;
+	MeshLoader& operator=(const MeshLoader&) = delete;
+
+	// Meshes cooked in the pack (as "<path>.mesh") are then viewed in place
+	// instead of going through their cache file. The pack must outlive the loader.
+	void setPack(AssetPack* assets) { pack = assets; }
+
+	std::shared_ptr<Entry> load(const std::string& path, VertexLayout layout);
+
+	// GL thread, once per frame: uploads at most byteBudget bytes of the
+	// meshes ready so far (a vertex more when decoding) and returns the bytes
+	// uploaded
+	size_t update(size_t byteBudget);
+
+	// Some mesh is still being read or uploaded
+	bool busy() const { return pending > 0; }
+
+private:
+	ThreadPool& pool;
+	AssetPack* pack = nullptr;
+	std::vector<std::future<void>> jobs;
+
+	std::mutex mutex;
+	std::vector<std::shared_ptr<Entry>> ready; // parsed, waiting for the GL thread
+
+	// Upload in progress: next buffer and offset within it
+	std::shared_ptr<Entry> uploading;
+	int uploadBuffer = 0;
+	size_t uploadOffset = 0;
+	StreamDecoder decoder; // of the buffer, when encoded
+
+	std::atomic<unsigned> pending{ 0 };
+};
@@ -0,0 +1,59 @@
+#include <stdio.h>
+
+#include "TextureArrays.h"
+#include "gputexture.h"
+#include "texturefile.h"
+
+size_t TextureArrays::load(AssetPack& pack)
+{
+	destroy();
+	for (size_t index = 0;; index++)
+	{
+		const ByteSpan entry = pack.find("texture-arrays/" + std::to_string(index) + ".tex");
+		TextureView view;
+		TextureFileHeader header;
+		if (entry.empty() || !viewTextureFile(entry.data, entry.size, view, header) || !view.layers)
+			break;
+
+		const GLuint texture = createTextureArray(view);
+		textures.push_back(texture);
+		for (uint32_t i = 0; i < view.layerCount; i++)
+		{
+			const TextureLayer& source = view.layers[i];
+			Layer& layer = layers[source.sourceHash];
+			layer.texture = texture;
+			layer.layer = i;
+			layer.uvScale = glm::vec2((float)source.width / view.width, (float)source.height / view.height);
+			layer.repeat = source.channels != 4;
+		}
+		printf("Texture array %zu: %u layers of %ux%u %s\n", index, view.layerCount, view.width, view.height, textureFormatName(view.format));
+	}
+	return textures.size();
+}
+
+void TextureArrays::destroy()
+{
+	if (!textures.empty())
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+	textures.clear();
+	layers.clear();
+}
+
+TextureArrays::Layer TextureArrays::find(AssetPack& pack, const std::string& path) const
+{
+	const ByteSpan cooked = pack.find(path + ".tex");
+	TextureView view;
+	TextureFileHeader header;
+	if (cooked.empty() || !viewTextureFile(cooked.data, cooked.size, view, header))
+		return Layer();
+	const auto found = layers.find(header.sourceHash);
+	return found != layers.end() ? found->second : Layer();
+}
+
+void TextureArrays::setUniforms(const Shader& shader, const Layer& layer)
+{
+	shader.setBool("textureArray", layer.texture != 0);
+	shader.setFloat("diffuseLayer", (float)layer.layer);
+	shader.setVec2("diffuseUvScale", layer.uvScale);
+	shader.setBool("diffuseRepeat", layer.repeat);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "AssetPack.h"
+#include "Shader.h"
+
+// Texture arrays cooked in the pack as "texture-arrays/<n>.tex", see
+// writeTextureArray: materials whose textures are layers of the same array
+// are drawn with it bound once, picking their layer through uniforms rather
+// than binding their own texture. Uploaded whole by load(). GL thread only.
+class TextureArrays
+{
+public:
+	// Where the texture of a material is, texture 0 when in no array
+	struct Layer
+	{
+		GLuint texture = 0;
+		uint32_t layer = 0;
+		glm::vec2 uvScale = glm::vec2(1.f); // of the layer the texture fills
+		bool repeat = false;                // wrapped like createTexture would
+	};
+
+	TextureArrays() = default;
+	TextureArrays(const TextureArrays&) = delete;
+	TextureArrays& operator=(const TextureArrays&) = delete;
+
+	// Uploads every array of the pack and returns how many there are
+	size_t load(AssetPack& pack);
+	void destroy();
+
+	// Layer of the texture cooked in the pack for the image of path, found
+	// by the hash of the image
+	Layer find(AssetPack& pack, const std::string& path) const;
+
+	size_t layerCount() const { return layers.size(); }
+
+	// Sets the diffuseArray uniforms of shader (in use) to draw with layer,
+	// the array being bound to the unit of diffuseArray already; texture 0
+	// draws with diffuseTexture instead
+	static void setUniforms(const Shader& shader, const Layer& layer);
+
+private:
+	std::vector<GLuint> textures;
+	std::unordered_map<uint64_t, Layer> layers; // by hash of the source image
+};
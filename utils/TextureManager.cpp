@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <stdio.h>
+
+#include "TextureManager.h"
+#include "gputexture.h"
+#include "hash.h"
+#include "stb_image.h"
+#include "texture.h"
+#include "Timer.h"
+
+namespace {
+
+// Cache entries of every compression can live side by side
+const char* const kCacheSuffixes[] = { "", "-bc", "-bc7" };
+
+const size_t kPageSize = 4096;
+
+// Of the levels resident
+size_t levelBytes(const TextureManager::Texture& texture)
+{
+	return textureBytes(std::max(texture.width >> texture.residentLevel, 1u), std::max(texture.height >> texture.residentLevel, 1u),
+		texture.levelCount - texture.residentLevel, texture.internalFormat);
+}
+
+// Levels shared by two textures of the same view, whose level 0 are
+// sourceLevel and targetLevel of it
+void copyLevels(const TextureView& view, GLuint source, uint32_t sourceLevel, GLuint target, uint32_t targetLevel)
+{
+	for (uint32_t level = std::max(sourceLevel, targetLevel); level < view.levelCount; level++)
+		glCopyImageSubData(source, GL_TEXTURE_2D, level - sourceLevel, 0, 0, 0, target, GL_TEXTURE_2D, level - targetLevel, 0, 0, 0,
+			std::max(view.width >> level, 1u), std::max(view.height >> level, 1u), 1);
+}
+
+const char* formatName(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+	case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+	case GL_R8: return "R8";
+	case GL_RG8: return "RG8";
+	case GL_RGB8: return "RGB8";
+	default: return "RGBA8";
+	}
+}
+
+}
+
+TextureManager::TextureManager(ThreadPool& pool)
+	: pool(pool)
+{
+}
+
+// A slot still held here was never uploaded from: release() fences the others
+TextureManager::Stream::~Stream()
+{
+	if (ring)
+		ring->release(slot);
+}
+
+bool TextureManager::setCache(const std::string& directory, TextureCompression compression)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	cacheDirectory = error ? std::string() : directory;
+	cacheCompression = compression;
+	return !error;
+}
+
+TextureManager::~TextureManager()
+{
+	wait();
+	for (const std::unique_ptr<Decode>& decode : decoded)
+	{
+		stbi_image_free(decode->pixels);
+		if (uploadRing)
+			uploadRing->release(decode->slot);
+	}
+}
+
+void TextureManager::wait()
+{
+	for (std::future<void>& job : jobs)
+		job.wait();
+}
+
+TextureManager::Handle TextureManager::load(const std::string& path)
+{
+	const auto known = byPath.find(path);
+	if (known != byPath.end())
+	{
+		const auto found = byHash.find(known->second);
+		if (found != byHash.end())
+			if (Handle texture = found->second.lock())
+				return texture;
+	}
+
+	// Cooked textures carry the hash of their image, others are hashed here,
+	// which is much cheaper than decoding them
+	auto decode = std::make_unique<Decode>();
+	decode->path = path;
+	TextureView view;
+	TextureFileHeader header;
+	const ByteSpan cooked = pack ? pack->find(path + ".tex") : ByteSpan();
+	const bool isCooked = !cooked.empty() && viewTextureFile(cooked.data, cooked.size, view, header);
+	if (isCooked)
+		decode->hash = header.sourceHash ? header.sourceHash : hash64(cooked.data, cooked.size);
+	else
+	{
+		if (pack)
+			decode->image = pack->read(path);
+		else if (decode->looseFile.open(path.c_str()))
+			decode->image = { decode->looseFile.data(), decode->looseFile.size() };
+		if (decode->image.empty())
+		{
+			printf("Texture failed to load at path: %s\n", path.c_str());
+			auto failed = std::make_shared<Texture>();
+			failed->path = path;
+			return failed;
+		}
+		decode->hash = hash64(decode->image.data, decode->image.size);
+	}
+
+	// Same image under another path
+	byPath[path] = decode->hash;
+	const auto found = byHash.find(decode->hash);
+	if (found != byHash.end())
+		if (Handle texture = found->second.lock())
+			return texture;
+
+	std::shared_ptr<Texture> texture(new Texture(), [this](const Texture* released) { release(released); });
+	texture->path = path;
+	texture->hash = decode->hash;
+	byHash[texture->hash] = texture;
+	if (isCooked)
+	{
+		upload(*texture, view, MappedFile());
+		return texture;
+	}
+
+	// Decoded before: the cache entry of that content is mapped as is
+	if (!cacheDirectory.empty())
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "/%016llx%s.tex", (unsigned long long)decode->hash, kCacheSuffixes[(int)cacheCompression]);
+		decode->cachePath = cacheDirectory + name;
+		MappedFile cacheFile;
+		if (mapTextureFile(decode->cachePath.c_str(), cacheFile, view, header) && header.sourceHash == decode->hash)
+		{
+			upload(*texture, view, std::move(cacheFile));
+			return texture;
+		}
+	}
+
+	pending++;
+	Decode* job = decode.release();
+	const TextureCompression compression = cacheCompression;
+	UploadRing* ring = uploadRing;
+	jobs.push_back(pool.submit([this, job, compression, ring]()
+	{
+		// The cache entry, mips and all, is built here and mapped; without a
+		// cache, or when it cannot be written, the image is only decoded
+		std::unique_ptr<Decode> decode(job);
+		Timer timer;
+		SourceInfo source;
+		source.size = decode->image.size;
+		source.hash = decode->hash;
+		decode->cached = !decode->cachePath.empty()
+			&& cookTexture(decode->image.data, decode->image.size, decode->path.c_str(), decode->cachePath.c_str(), compression, source)
+			&& mapTextureFile(decode->cachePath.c_str(), decode->cacheFile, decode->view, decode->header);
+		if (decode->cached)
+			printf("Built texture cache %s in %.2f ms\n", decode->cachePath.c_str(), timer.elapsed() * 1000.f);
+		else
+		{
+			// Straight into a slot of the upload ring, RGB or RGBA like the image.
+			// The fallback decodes to the same, so the texture does not depend
+			// on a slot being free.
+			int channels = 0;
+			if (imageInfo(decode->image.data, decode->image.size, decode->width, decode->height, &channels))
+			{
+				const PixelFormat format = channels == 2 || channels == 4 ? PixelFormat::RGBA : PixelFormat::RGB;
+				decode->channels = (int)channelCount(format);
+				if (ring)
+					decode->slot = ring->acquire((size_t)decode->width * decode->height * decode->channels);
+				if (decode->slot.valid() && !decodeImage(decode->image.data, decode->image.size, format, false, decode->slot.data, ring->slotBytes()))
+					ring->release(decode->slot);
+				if (!decode->slot.valid())
+					decode->pixels = stbi_load_from_memory((const stbi_uc*)decode->image.data, (int)decode->image.size,
+						&decode->width, &decode->height, &channels, decode->channels);
+			}
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.push_back(std::move(decode));
+	}));
+	return texture;
+}
+
+void TextureManager::request(const Handle& texture, float uvPerPixel)
+{
+	const auto found = streams.find(texture->hash);
+	if (found == streams.end())
+		return;
+	const float texels = uvPerPixel * std::max(texture->width, texture->height);
+	const uint32_t level = texels > 1.f ? (uint32_t)std::log2(texels) : 0;
+	found->second->frameLevel = std::min(found->second->frameLevel, level);
+}
+
+size_t TextureManager::update(size_t byteBudget)
+{
+	std::vector<std::unique_ptr<Decode>> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.swap(decoded);
+	}
+
+	for (const std::unique_ptr<Decode>& decode : ready)
+	{
+		// Nothing to do when every handle went away meanwhile
+		const auto found = byHash.find(decode->hash);
+		const std::shared_ptr<Texture> texture = found != byHash.end() ? found->second.lock() : nullptr;
+		if (!decode->cached && !decode->pixels && !decode->slot.valid())
+			printf("Texture failed to decode at path: %s\n", decode->path.c_str());
+		else if (texture && texture->name == 0)
+		{
+			if (decode->cached)
+				upload(*texture, decode->view, std::move(decode->cacheFile));
+			else
+				upload(*texture, *decode);
+		}
+		stbi_image_free(decode->pixels);
+		if (uploadRing)
+			uploadRing->release(decode->slot); // not uploaded from
+		pending--;
+	}
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const std::future<void>& job)
+	{
+		return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), jobs.end());
+
+	// Finer levels are wanted as soon as requested, coarser ones once no
+	// request asked for more for a while
+	std::vector<std::pair<Texture*, Stream*>> growing;
+	for (auto& entry : streams)
+	{
+		const std::shared_ptr<Texture> texture = byHash[entry.first].lock();
+		Stream& stream = *entry.second;
+		if (!texture)
+			continue;
+		if (stream.frameLevel <= stream.wantedLevel || ++stream.coarserFrames > kKeepFrames)
+		{
+			stream.wantedLevel = stream.frameLevel;
+			stream.coarserFrames = 0;
+		}
+		stream.frameLevel = stream.startLevel;
+
+		if (stream.wantedLevel > texture->residentLevel && !stream.reading)
+			shrink(*texture, stream);
+		else if (stream.wantedLevel < texture->residentLevel && !stream.reading)
+		{
+			// Copying the level into a slot of the upload ring, or else
+			// touching a byte per page, reads it from disk here rather than
+			// while the GL thread uploads it
+			stream.reading = true;
+			stream.ring = uploadRing;
+			const std::shared_ptr<Stream> shared = entry.second;
+			const uint32_t level = texture->residentLevel - 1;
+			jobs.push_back(pool.submit([shared, level]()
+			{
+				const uint8_t* data = shared->view.levels[level];
+				const size_t size = shared->view.levelSizes[level];
+				if (shared->ring)
+					shared->slot = shared->ring->acquire(size);
+				if (shared->slot.valid())
+					memcpy(shared->slot.data, data, size);
+				else
+				{
+					unsigned sum = 0;
+					for (size_t i = 0; i < size; i += kPageSize)
+						sum += data[i];
+					volatile unsigned touched = sum;
+					(void)touched;
+				}
+				shared->read = true;
+			}));
+		}
+		// A level read before requests went coarser is not wanted anymore
+		if (stream.read && stream.wantedLevel >= texture->residentLevel)
+			cancelGrow(stream);
+		else if (stream.read)
+			growing.emplace_back(texture.get(), &stream);
+	}
+
+	// Textures drawn the most blurry first
+	std::sort(growing.begin(), growing.end(), [](const std::pair<Texture*, Stream*>& a, const std::pair<Texture*, Stream*>& b)
+	{
+		return (int)a.first->residentLevel - (int)a.second->wantedLevel > (int)b.first->residentLevel - (int)b.second->wantedLevel;
+	});
+	size_t uploaded = 0;
+	for (size_t i = 0; i < growing.size() && uploaded < byteBudget; i++)
+		uploaded += grow(*growing[i].first, *growing[i].second, byteBudget - uploaded);
+	return uploaded;
+}
+
+void TextureManager::shrink(Texture& texture, Stream& stream)
+{
+	const GLuint smaller = createTextureStorage(stream.view, stream.wantedLevel);
+	copyLevels(stream.view, texture.name, texture.residentLevel, smaller, stream.wantedLevel);
+	glDeleteTextures(1, &texture.name);
+	texture.name = smaller;
+	texture.residentLevel = stream.wantedLevel;
+	bytes -= texture.bytes;
+	texture.bytes = levelBytes(texture);
+	bytes += texture.bytes;
+}
+
+void TextureManager::cancelGrow(Stream& stream)
+{
+	if (uploadRing)
+		uploadRing->submit(stream.slot); // rows may have been uploaded from it
+	glDeleteTextures(1, &stream.growing);
+	stream.growing = 0;
+	stream.reading = false;
+	stream.read = false;
+}
+
+size_t TextureManager::grow(Texture& texture, Stream& stream, size_t byteBudget)
+{
+	const TextureView& view = stream.view;
+	const uint32_t level = texture.residentLevel - 1;
+	if (!stream.growing)
+	{
+		stream.growing = createTextureStorage(view, level);
+		copyLevels(view, texture.name, texture.residentLevel, stream.growing, level);
+		stream.rowsUploaded = 0;
+	}
+
+	const uint32_t rowCount = levelRowCount(view, level);
+	const size_t rowBytes = view.levelSizes[level] / rowCount;
+	const uint32_t rows = (uint32_t)std::min<size_t>(rowCount - stream.rowsUploaded, std::max<size_t>(byteBudget / rowBytes, 1));
+	if (stream.slot.valid())
+	{
+		uploadRing->bind();
+		uploadLevelRows(stream.growing, 0, view, level, stream.rowsUploaded, rows, uploadRing->pixels(stream.slot));
+		uploadRing->unbind();
+	}
+	else
+		uploadLevelRows(stream.growing, 0, view, level, stream.rowsUploaded, rows);
+	stream.rowsUploaded += rows;
+	if (stream.rowsUploaded == rowCount)
+	{
+		if (uploadRing)
+			uploadRing->submit(stream.slot);
+		glDeleteTextures(1, &texture.name);
+		texture.name = stream.growing;
+		texture.residentLevel = level;
+		bytes -= texture.bytes;
+		texture.bytes = levelBytes(texture);
+		bytes += texture.bytes;
+		stream.growing = 0;
+		stream.reading = false;
+		stream.read = false;
+	}
+	return rows * rowBytes;
+}
+
+void TextureManager::upload(Texture& texture, const TextureView& cooked, MappedFile file)
+{
+	auto stream = std::make_shared<Stream>();
+	stream->file = std::move(file);
+	stream->view = cooked;
+	while (stream->startLevel + 1 < cooked.levelCount && std::max(cooked.width, cooked.height) >> stream->startLevel > kStartSize)
+		stream->startLevel++;
+	stream->wantedLevel = stream->frameLevel = stream->startLevel;
+
+	texture.name = createTexture(cooked, stream->startLevel);
+	texture.width = cooked.width;
+	texture.height = cooked.height;
+	texture.levelCount = cooked.levelCount;
+	texture.residentLevel = stream->startLevel;
+	texture.internalFormat = internalFormat(cooked.format);
+	texture.bytes = levelBytes(texture);
+	bytes += texture.bytes;
+	streams[texture.hash] = std::move(stream);
+}
+
+void TextureManager::upload(Texture& texture, Decode& decode)
+{
+	if (decode.slot.valid())
+	{
+		uploadRing->bind();
+		texture.name = createTexture(uploadRing->pixels(decode.slot), decode.width, decode.height, decode.channels);
+		uploadRing->unbind();
+		uploadRing->submit(decode.slot);
+	}
+	else
+		texture.name = createTexture(decode.pixels, decode.width, decode.height, decode.channels);
+	texture.width = decode.width;
+	texture.height = decode.height;
+	texture.levelCount = mipLevelCount(decode.width, decode.height);
+	texture.internalFormat = internalFormat(decode.channels);
+	texture.bytes = textureBytes(texture.width, texture.height, texture.levelCount, texture.internalFormat);
+	bytes += texture.bytes;
+}
+
+void TextureManager::release(const Texture* texture)
+{
+	const auto stream = streams.find(texture->hash);
+	if (stream != streams.end())
+	{
+		// Rows may have been uploaded from the slot already
+		if (stream->second->read && uploadRing)
+			uploadRing->submit(stream->second->slot);
+		glDeleteTextures(1, &stream->second->growing);
+		streams.erase(stream);
+	}
+	glDeleteTextures(1, &texture->name);
+	bytes -= texture->bytes;
+	byHash.erase(texture->hash);
+	for (auto it = byPath.begin(); it != byPath.end();)
+		it = it->second == texture->hash ? byPath.erase(it) : std::next(it);
+	delete texture;
+}
+
+void TextureManager::printResident() const
+{
+	for (const auto& entry : byHash)
+	{
+		const Handle texture = entry.second.lock();
+		if (!texture || texture->name == 0)
+			continue;
+		printf("Texture %s: %ux%u %s, %u of %u levels, %.1f KB, %ld references\n", texture->path.c_str(), texture->width, texture->height,
+			formatName(texture->internalFormat), texture->levelCount - texture->residentLevel, texture->levelCount, texture->bytes / 1024.0,
+			texture.use_count() - 1);
+	}
+	printf("%zu textures resident (%.1f MB)\n", textureCount(), bytes / (1024.0 * 1024.0));
+}
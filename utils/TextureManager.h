@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "texturefile.h"
+#include "ThreadPool.h"
+#include "UploadRing.h"
+
+// Textures shared by every material that uses them: loading a path twice, or
+// two paths holding the same image, gives the same GL texture. Handles are
+// reference counted and the texture is deleted with the last of them.
+// Images are decoded by worker threads and uploaded by update() on the GL
+// thread. Cooked textures need no decoding, and so are images decoded by an
+// earlier run, from the cache: these are streamed, only their smallest levels
+// being uploaded at first and finer ones as request() asks for them.
+// With an upload ring, images are decoded and levels read straight into its
+// slots, and uploaded from there.
+// GL thread only; the manager must outlive its handles.
+class TextureManager
+{
+public:
+	struct Texture
+	{
+		std::string path;  // first path it was loaded from
+		uint64_t hash = 0; // of the source image
+		GLuint name = 0;   // 0 until uploaded, or when it failed to load
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t levelCount = 0;
+		uint32_t residentLevel = 0; // finest level resident, the others being coarser
+		GLenum internalFormat = 0;
+		size_t bytes = 0;  // resident, mips included
+	};
+	using Handle = std::shared_ptr<const Texture>;
+
+	explicit TextureManager(ThreadPool& pool = ThreadPool::shared());
+	~TextureManager();
+
+	TextureManager(const TextureManager&) = delete;
+	TextureManager& operator=(const TextureManager&) = delete;
+
+	// Cooked textures in the pack (as "<path>.tex") are used instead of
+	// their image, and images are read through it. The pack must outlive
+	// the manager.
+	void setPack(AssetPack* assets) { pack = assets; }
+
+	// Directory of the images decoded so far, as cooked textures (mips
+	// included, compressed as asked) named after the hash of their image:
+	// mapping one takes no decoding, and a changed image simply misses.
+	// false when the directory cannot be created, leaving the cache off.
+	bool setCache(const std::string& directory, TextureCompression compression = TextureCompression::None);
+
+	// Ring whose slots the workers fill for update() to upload from, memory
+	// of their own being used when no slot is free. The ring must outlive
+	// the manager, and update() it once per frame.
+	void setUploadRing(UploadRing* ring) { uploadRing = ring; }
+
+	// Handle to the texture of path; textures that failed to load get one
+	// too, to texture 0, so that binding it unbinds
+	Handle load(const std::string& path);
+
+	// Texels a pixel needs this frame where texture is drawn closest to the
+	// eye, given the uv distance covered by a pixel there. Streamed textures
+	// grow a level at a time up to the finest level requested, and drop the
+	// levels no request asked for over the last kKeepFrames frames.
+	void request(const Handle& texture, float uvPerPixel);
+
+	// Once per frame: uploads the images decoded so far, then at most
+	// byteBudget bytes (a row more) of streamed levels, the textures missing
+	// the most levels first, and returns the bytes streamed
+	size_t update(size_t byteBudget);
+
+	// Some image is still being decoded or waiting for update()
+	bool busy() const { return pending > 0; }
+
+	// Waits for the workers, which may be writing into the upload ring
+	void wait();
+
+	size_t textureCount() const { return byHash.size(); }
+	size_t residentBytes() const { return bytes; }
+
+	// One line per resident texture: size, format, bytes and references
+	void printResident() const;
+
+private:
+	// Image being decoded by a worker
+	struct Decode
+	{
+		uint64_t hash = 0;
+		std::string path;
+		MappedFile looseFile; // holds image when there is no pack
+		ByteSpan image;
+
+		// Cache entry, written and mapped by the worker
+		std::string cachePath;
+		bool cached = false;
+		MappedFile cacheFile;
+		TextureView view;
+		TextureFileHeader header;
+
+		// Or else its pixels, mipmapped by GL: in a slot of the upload ring,
+		// or in memory of stb_image when none was free
+		UploadRing::Slot slot;
+		uint8_t* pixels = nullptr;
+		int width = 0, height = 0, channels = 0;
+	};
+
+	// Levels of a cooked texture not resident yet: the next finer one is read
+	// by a worker, faulting in its pages, then uploaded rows at a time into
+	// a texture one level larger, which replaces it once complete
+	struct Stream
+	{
+		~Stream();
+
+		MappedFile file; // the cache entry, unless view is in the pack
+		TextureView view;
+		uint32_t startLevel = 0;    // resident from the start
+		uint32_t wantedLevel = 0;   // finest level requested lately
+		uint32_t frameLevel = 0;    // finest level requested this frame
+		unsigned coarserFrames = 0; // frames requested coarser than wantedLevel
+		bool reading = false;
+		std::atomic<bool> read{ false };
+		UploadRing* ring = nullptr;
+		UploadRing::Slot slot;      // the level read into it, when one was free
+		GLuint growing = 0;         // one level larger, being filled
+		uint32_t rowsUploaded = 0;
+	};
+
+	static const uint32_t kStartSize = 64; // texels, of the largest level resident at first
+	static const unsigned kKeepFrames = 120;
+
+	void upload(Texture& texture, const TextureView& cooked, MappedFile file);
+	void upload(Texture& texture, Decode& decode);
+	void shrink(Texture& texture, Stream& stream);
+	size_t grow(Texture& texture, Stream& stream, size_t byteBudget);
+	void cancelGrow(Stream& stream);
+	void release(const Texture* texture);
+
+	ThreadPool& pool;
+	AssetPack* pack = nullptr;
+	UploadRing* uploadRing = nullptr;
+	std::string cacheDirectory;
+	TextureCompression cacheCompression = TextureCompression::None;
+	std::unordered_map<std::string, uint64_t> byPath;
+	std::unordered_map<uint64_t, std::weak_ptr<Texture>> byHash;
+	std::unordered_map<uint64_t, std::shared_ptr<Stream>> streams; // shared with reading workers
+	size_t bytes = 0;
+
+	std::vector<std::future<void>> jobs;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Decode>> decoded; // waiting for the GL thread
+	std::atomic<unsigned> pending{ 0 };
+};
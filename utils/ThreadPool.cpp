@@ -0,0 +1,104 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	workers.reserve(threads);
+	for (unsigned i = 0; i < threads; i++)
+		workers.emplace_back([this]() { run(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::push(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push(std::move(job));
+	}
+	wakeup.notify_one();
+}
+
+void ThreadPool::run()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeup.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop();
+		}
+		job();
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body, unsigned maxThreads)
+{
+	if (count == 0)
+		return;
+
+	size_t helpers = std::min<size_t>(size(), count - 1);
+	if (maxThreads > 0)
+		helpers = std::min<size_t>(helpers, maxThreads - 1);
+	if (helpers == 0)
+	{
+		for (size_t i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	// Indices are handed out through a shared counter. Helpers that start late
+	// simply find nothing left to do, so the caller never waits on queued jobs.
+	struct State
+	{
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	auto state = std::make_shared<State>();
+
+	auto work = [state, count, &body]()
+	{
+		size_t completed = 0;
+		for (size_t i = state->next++; i < count; i = state->next++)
+		{
+			body(i);
+			++completed;
+		}
+		if (completed && state->done.fetch_add(completed) + completed == count)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->finished.notify_all();
+		}
+	};
+
+	for (size_t i = 0; i < helpers; i++)
+		push(work);
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&]() { return state->done == count; });
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads pulling jobs from a FIFO queue.
+class ThreadPool
+{
+public:
+	// 0 threads means one per hardware thread
+	explicit ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned size() const { return (unsigned)workers.size(); }
+
+	template <class F>
+	auto submit(F&& f) -> std::future<decltype(f())>
+	{
+		using Result = decltype(f());
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+		std::future<Result> result = task->get_future();
+		push([task]() { (*task)(); });
+		return result;
+	}
+
+	// Runs body(i) for every i in [0, count) and returns once all calls are done.
+	// The calling thread takes part in the work, so it is safe to call from a job.
+	// maxThreads bounds the number of threads (caller included), 0 meaning no bound.
+	void parallelFor(size_t count, const std::function<void(size_t)>& body, unsigned maxThreads = 0);
+
+	// Process-wide pool shared by the loaders
+	static ThreadPool& shared();
+
+private:
+	void push(std::function<void()> job);
+	void run();
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	bool stopping = false;
+};
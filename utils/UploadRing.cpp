@@ -0,0 +1,115 @@
+#include <cstdint>
+#include <stdio.h>
+
+#include "UploadRing.h"
+
+bool UploadRing::create(uint32_t slotCount, size_t slotBytes)
+{
+	destroy();
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr size = (GLsizeiptr)(slotCount * slotBytes);
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, nullptr, flags);
+	mapped = (uint8_t*)glMapNamedBufferRange(buffer, 0, size, flags);
+	if (!mapped)
+	{
+		destroy();
+		return false;
+	}
+
+	bytesPerSlot = slotBytes;
+	fences.assign(slotCount, nullptr);
+	std::lock_guard<std::mutex> lock(mutex);
+	for (uint32_t slot = slotCount; slot-- > 0;)
+		freeSlots.push_back(slot);
+	return true;
+}
+
+void UploadRing::destroy()
+{
+	for (GLsync& fence : fences)
+		if (fence)
+			glDeleteSync(fence);
+	fences.clear();
+	if (mapped)
+		glUnmapNamedBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+	mapped = nullptr;
+	bytesPerSlot = 0;
+	std::lock_guard<std::mutex> lock(mutex);
+	freeSlots.clear();
+}
+
+UploadRing::Slot UploadRing::acquire(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Slot slot;
+	if (freeSlots.empty() || bytes > bytesPerSlot)
+	{
+		missed++;
+		return slot;
+	}
+	slot.index = freeSlots.back();
+	slot.data = mapped + slot.index * bytesPerSlot;
+	freeSlots.pop_back();
+	acquired++;
+	return slot;
+}
+
+void UploadRing::release(Slot& slot)
+{
+	if (!slot.valid())
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	freeSlots.push_back(slot.index);
+	slot = Slot();
+}
+
+void UploadRing::bind() const
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+}
+
+void UploadRing::unbind() const
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+const uint8_t* UploadRing::pixels(const Slot& slot, size_t offset) const
+{
+	return reinterpret_cast<const uint8_t*>((uintptr_t)(slot.index * bytesPerSlot + offset));
+}
+
+void UploadRing::submit(Slot& slot)
+{
+	if (!slot.valid())
+		return;
+	fences[slot.index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot = Slot();
+}
+
+void UploadRing::update()
+{
+	for (uint32_t index = 0; index < fences.size(); index++)
+	{
+		GLsync& fence = fences[index];
+		if (!fence)
+			continue;
+		const GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(fence);
+		fence = nullptr;
+		std::lock_guard<std::mutex> lock(mutex);
+		freeSlots.push_back(index);
+	}
+}
+
+void UploadRing::printStats() const
+{
+	if (!buffer)
+		return;
+	printf("Upload ring: %zu slots of %.1f MB, %llu filled, %llu missed\n", fences.size(), bytesPerSlot / (1024.0 * 1024.0),
+		(unsigned long long)acquired, (unsigned long long)missed);
+}
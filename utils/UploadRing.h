@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Pixel unpack buffer mapped once for good (persistent and coherent), cut in
+// slots of the same size: worker threads decode or copy texels straight into
+// a free slot, and the GL thread uploads from it, the driver reading the
+// buffer rather than copying client memory while the call blocks. A fence
+// after the uploads of a slot tells when the GPU is done with it, and only
+// then is the slot handed out again.
+// Slots are acquired and released from any thread, the rest is GL thread only.
+class UploadRing
+{
+public:
+	struct Slot
+	{
+		uint32_t index = ~0u;
+		uint8_t* data = nullptr; // mapped, slotBytes() long
+
+		bool valid() const { return data != nullptr; }
+	};
+
+	UploadRing() = default;
+
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+	// false when the buffer cannot be created or mapped, every acquire()
+	// failing then. destroy() must be called while the GL context is current.
+	bool create(uint32_t slotCount, size_t slotBytes);
+	void destroy();
+
+	// A free slot for bytes, invalid when they do not fit a slot or none is
+	// free: the caller falls back to client memory
+	Slot acquire(size_t bytes);
+
+	// Gives back a slot no upload was made from
+	void release(Slot& slot);
+
+	// Binds the buffer as GL_PIXEL_UNPACK_BUFFER, the pixels of texture
+	// uploads being then offsets into it, see pixels()
+	void bind() const;
+	void unbind() const;
+	const uint8_t* pixels(const Slot& slot, size_t offset = 0) const;
+
+	// The uploads from slot are all issued: it is free again once the GPU
+	// has read them
+	void submit(Slot& slot);
+
+	// Once per frame: frees the slots whose uploads are done
+	void update();
+
+	size_t slotBytes() const { return bytesPerSlot; }
+	void printStats() const;
+
+private:
+	GLuint buffer = 0;
+	uint8_t* mapped = nullptr;
+	size_t bytesPerSlot = 0;
+	std::vector<GLsync> fences; // by slot, while the GPU may read it
+
+	std::mutex mutex;
+	std::vector<uint32_t> freeSlots;
+	uint64_t acquired = 0;
+	uint64_t missed = 0; // no slot free, or too small
+};
@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdio.h>
+
+#include "VirtualTexture.h"
+#include "gputexture.h"
+
+namespace {
+
+uint32_t nextPowerOfTwo(uint32_t value)
+{
+	uint32_t power = 1;
+	while (power < value)
+		power *= 2;
+	return power;
+}
+
+}
+
+VirtualTexture::VirtualTexture(ThreadPool& pool)
+	: pool(pool)
+{
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	for (std::future<void>& job : jobs)
+		job.wait();
+}
+
+bool VirtualTexture::create(const TextureView& source, uint32_t slotCount, uint32_t width, uint32_t height, uint32_t scale)
+{
+	destroy();
+
+	// The indirection texture halves with each level like the tiles do, down
+	// to the level held by a single tile
+	view = source;
+	tableWidth = nextPowerOfTwo((view.width + kTileSize - 1) / kTileSize);
+	tableHeight = nextPowerOfTwo((view.height + kTileSize - 1) / kTileSize);
+	levelCount = 1;
+	while ((std::max(tableWidth, tableHeight) >> (levelCount - 1)) > 1)
+		levelCount++;
+	if (tableWidth > 256 || tableHeight > 256 || levelCount > view.levelCount)
+	{
+		printf("Virtual texture of %ux%u texels and %u levels not supported\n", view.width, view.height, view.levelCount);
+		return false;
+	}
+
+	const bool blocks = view.format != TextureFormat::RGBA8;
+	const uint32_t slotUnits = kSlotSize / (blocks ? 4 : 1);
+	tileBytes = (size_t)slotUnits * slotUnits * (view.format == TextureFormat::BC1 ? 8 : blocks ? 16 : 4);
+	slotsPerSide = slotCount;
+	slots.assign((size_t)slotsPerSide * slotsPerSide, Slot());
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &cache);
+	glTextureStorage2D(cache, 1, internalFormat(view.format), slotsPerSide * kSlotSize, slotsPerSide * kSlotSize);
+	glTextureParameteri(cache, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(cache, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(cache, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(cache, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &indirection);
+	glTextureStorage2D(indirection, levelCount, GL_RGBA8UI, tableWidth, tableHeight);
+	glTextureParameteri(indirection, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(indirection, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	table.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++)
+		table[level].assign((size_t)std::max(tableWidth >> level, 1u) * std::max(tableHeight >> level, 1u) * 4, 0);
+
+	// Levels coarser than a tile are sampled from the mip tail instead
+	tail = createTexture(view, levelCount - 1);
+
+	// The coarsest tile never leaves, every lookup falls back to it
+	Tile top;
+	top.key = tileKey(levelCount - 1, 0, 0);
+	cutTile(top.key, top.data);
+	uploadTile(0, top);
+	slots[0].lastSeen = UINT64_MAX;
+	updateIndirection();
+
+	feedbackScale = std::max(scale, 1u);
+	lodBias = -std::log2((float)feedbackScale);
+	setFrameSize(width, height);
+	return true;
+}
+
+void VirtualTexture::setFrameSize(uint32_t width, uint32_t height)
+{
+	if (framebuffer && width == frameWidth && height == frameHeight)
+		return;
+	destroyFeedback();
+
+	// Feedback target, and the buffers it is read back through
+	frameWidth = width;
+	frameHeight = height;
+	feedbackWidth = std::max(frameWidth / feedbackScale, 1u);
+	feedbackHeight = std::max(frameHeight / feedbackScale, 1u);
+	glCreateRenderbuffers(1, &colorBuffer);
+	glNamedRenderbufferStorage(colorBuffer, GL_RGBA8, feedbackWidth, feedbackHeight);
+	glCreateRenderbuffers(1, &depthBuffer);
+	glNamedRenderbufferStorage(depthBuffer, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	glCreateBuffers(kFeedbackBuffers, readBuffers);
+	for (GLuint buffer : readBuffers)
+		glNamedBufferStorage(buffer, (GLsizeiptr)feedbackWidth * feedbackHeight * 4, nullptr, GL_MAP_READ_BIT);
+}
+
+void VirtualTexture::destroyFeedback()
+{
+	for (GLsync& fence : fences)
+	{
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	nextFeedback = 0;
+	glDeleteBuffers(kFeedbackBuffers, readBuffers);
+	memset(readBuffers, 0, sizeof(readBuffers));
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	framebuffer = colorBuffer = depthBuffer = 0;
+}
+
+void VirtualTexture::destroy()
+{
+	for (std::future<void>& job : jobs)
+		job.wait();
+	jobs.clear();
+	cut.clear();
+	loading.clear();
+	resident.clear();
+	slots.clear();
+	table.clear();
+	tableDirty = true;
+
+	destroyFeedback();
+	glDeleteTextures(1, &cache);
+	glDeleteTextures(1, &indirection);
+	glDeleteTextures(1, &tail);
+	cache = indirection = tail = 0;
+}
+
+void VirtualTexture::setLevelUniforms(const Shader& shader, float bias) const
+{
+	shader.setVec2("virtualSize", glm::vec2(view.width, view.height));
+	shader.setFloat("virtualMaxLevel", (float)(levelCount - 1));
+	shader.setBool("virtualRepeat", view.channels != 4);
+	shader.setFloat("virtualTileSize", (float)kTileSize);
+	shader.setFloat("virtualLodBias", bias);
+}
+
+void VirtualTexture::setUniforms(const Shader& shader, GLuint cacheUnit, GLuint indirectionUnit, GLuint tailUnit) const
+{
+	glBindTextureUnit(cacheUnit, cache);
+	glBindTextureUnit(indirectionUnit, indirection);
+	glBindTextureUnit(tailUnit, tail);
+	shader.setInt("virtualCache", (int)cacheUnit);
+	shader.setInt("virtualIndirection", (int)indirectionUnit);
+	shader.setInt("virtualTail", (int)tailUnit);
+	shader.setFloat("virtualTileBorder", (float)kTileBorder);
+	shader.setFloat("virtualCacheSize", (float)(slotsPerSide * kSlotSize));
+	setLevelUniforms(shader, 0.f);
+}
+
+void VirtualTexture::setFeedbackUniforms(const Shader& shader) const
+{
+	// Derivatives are feedbackScale times larger at that resolution
+	setLevelUniforms(shader, lodBias);
+}
+
+void VirtualTexture::beginFeedback()
+{
+	glGetIntegerv(GL_VIEWPORT, savedViewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, savedClearColor);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, feedbackWidth, feedbackHeight);
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTexture::endFeedback()
+{
+	// Copied into the next free buffer, skipped when they all wait for update()
+	if (!fences[nextFeedback])
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers[nextFeedback]);
+		glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		fences[nextFeedback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		nextFeedback = (nextFeedback + 1) % kFeedbackBuffers;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+	glClearColor(savedClearColor[0], savedClearColor[1], savedClearColor[2], savedClearColor[3]);
+}
+
+size_t VirtualTexture::update(size_t byteBudget)
+{
+	frame++;
+
+	// Oldest feedback, once its copy is complete
+	for (unsigned i = 0; i < kFeedbackBuffers; i++)
+	{
+		const unsigned index = (nextFeedback + i) % kFeedbackBuffers;
+		if (!fences[index])
+			continue;
+		const GLenum status = glClientWaitSync(fences[index], 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(fences[index]);
+		fences[index] = nullptr;
+
+		std::vector<uint32_t> wanted;
+		const size_t size = (size_t)feedbackWidth * feedbackHeight * 4;
+		const uint8_t* pixels = (const uint8_t*)glMapNamedBufferRange(readBuffers[index], 0, size, GL_MAP_READ_BIT);
+		if (pixels)
+		{
+			for (size_t p = 0; p < size; p += 4)
+				if (pixels[p + 3])
+					wanted.push_back(tileKey(pixels[p + 2], pixels[p], pixels[p + 1]));
+			glUnmapNamedBuffer(readBuffers[index]);
+		}
+		feedbackRead++;
+		request(wanted);
+		break;
+	}
+
+	std::vector<Tile> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.swap(cut);
+	}
+	size_t uploaded = 0;
+	size_t i = 0;
+	for (; i < ready.size() && uploaded * tileBytes < byteBudget; i++)
+	{
+		// Least recently seen slot, but none seen this frame: when they all
+		// are, the tile is dropped and asked for again by a later feedback
+		Tile& tile = ready[i];
+		loading.erase(tile.key);
+		uint32_t slot = kNoTile;
+		uint64_t oldest = frame;
+		for (uint32_t s = 0; s < slots.size(); s++)
+			if (slots[s].lastSeen < oldest)
+			{
+				oldest = slots[s].lastSeen;
+				slot = s;
+			}
+		if (slot == kNoTile)
+			continue;
+		if (slots[slot].key != kNoTile)
+		{
+			resident.erase(slots[slot].key);
+			tilesEvicted++;
+		}
+		uploadTile(slot, tile);
+		slots[slot].lastSeen = frame;
+		uploaded++;
+	}
+	if (i < ready.size())
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		cut.insert(cut.begin(), std::make_move_iterator(ready.begin() + i), std::make_move_iterator(ready.end()));
+	}
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const std::future<void>& job)
+	{
+		return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}), jobs.end());
+
+	if (tableDirty)
+		updateIndirection();
+	return uploaded;
+}
+
+void VirtualTexture::request(const std::vector<uint32_t>& feedback)
+{
+	std::vector<uint32_t> wanted = feedback;
+	std::sort(wanted.begin(), wanted.end());
+	wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+	// Tiles seen, and their ancestors which stand in for them meanwhile
+	std::vector<uint32_t> missing;
+	for (uint32_t key : wanted)
+	{
+		uint32_t x = key & 0xFF, y = key >> 8 & 0xFF;
+		for (uint32_t level = key >> 16; level < levelCount; level++, x /= 2, y /= 2)
+		{
+			if (x >= std::max(tableWidth >> level, 1u) || y >= std::max(tableHeight >> level, 1u))
+				continue;
+			const uint32_t tile = tileKey(level, x, y);
+			const auto found = resident.find(tile);
+			if (found == resident.end())
+			{
+				if (!loading.count(tile))
+					missing.push_back(tile);
+			}
+			else if (slots[found->second].lastSeen != UINT64_MAX)
+				slots[found->second].lastSeen = frame;
+		}
+	}
+
+	// Coarsest first, the level being the high bits of keys, and no more
+	// than the slots not in view can take
+	std::sort(missing.begin(), missing.end(), std::greater<uint32_t>());
+	missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+	const size_t free = std::count_if(slots.begin(), slots.end(), [this](const Slot& slot) { return slot.lastSeen < frame; });
+	const size_t maxLoading = std::min(kMaxLoading, free);
+	for (size_t i = 0; i < missing.size() && loading.size() < maxLoading; i++)
+	{
+		const uint32_t key = missing[i];
+		loading.insert(key);
+		jobs.push_back(pool.submit([this, key]()
+		{
+			Tile tile;
+			tile.key = key;
+			cutTile(key, tile.data);
+			std::lock_guard<std::mutex> lock(mutex);
+			cut.push_back(std::move(tile));
+		}));
+	}
+}
+
+void VirtualTexture::cutTile(uint32_t key, std::vector<uint8_t>& data) const
+{
+	// Copied in texels, or blocks of compressed formats, the border wrapping
+	// around repeated textures and clamped on the others
+	const uint32_t level = key >> 16, tileX = key & 0xFF, tileY = key >> 8 & 0xFF;
+	const bool blocks = view.format != TextureFormat::RGBA8;
+	const uint32_t unit = blocks ? 4 : 1;
+	const size_t unitBytes = view.format == TextureFormat::BC1 ? 8 : blocks ? 16 : 4;
+	const int unitsX = (int)((std::max(view.width >> level, 1u) + unit - 1) / unit);
+	const int unitsY = (int)((std::max(view.height >> level, 1u) + unit - 1) / unit);
+	const bool repeat = view.channels != 4;
+	auto wrap = [repeat](int i, int count)
+	{
+		return repeat ? (i % count + count) % count : std::min(std::max(i, 0), count - 1);
+	};
+
+	const uint32_t slotUnits = kSlotSize / unit;
+	const int left = (int)(tileX * kTileSize / unit) - (int)(kTileBorder / unit);
+	const int top = (int)(tileY * kTileSize / unit) - (int)(kTileBorder / unit);
+	data.resize(tileBytes);
+	for (uint32_t y = 0; y < slotUnits; y++)
+	{
+		const uint8_t* row = view.levels[level] + (size_t)wrap(top + (int)y, unitsY) * unitsX * unitBytes;
+		uint8_t* out = &data[(size_t)y * slotUnits * unitBytes];
+		for (uint32_t x = 0; x < slotUnits; x++)
+			memcpy(out + x * unitBytes, row + (size_t)wrap(left + (int)x, unitsX) * unitBytes, unitBytes);
+	}
+}
+
+void VirtualTexture::uploadTile(uint32_t slot, const Tile& tile)
+{
+	const GLint x = (GLint)((slot % slotsPerSide) * kSlotSize);
+	const GLint y = (GLint)((slot / slotsPerSide) * kSlotSize);
+	if (view.format == TextureFormat::RGBA8)
+		glTextureSubImage2D(cache, 0, x, y, kSlotSize, kSlotSize, GL_RGBA, GL_UNSIGNED_BYTE, tile.data.data());
+	else
+		glCompressedTextureSubImage2D(cache, 0, x, y, kSlotSize, kSlotSize, internalFormat(view.format), (GLsizei)tile.data.size(), tile.data.data());
+	slots[slot].key = tile.key;
+	resident[tile.key] = slot;
+	tableDirty = true;
+	tilesUploaded++;
+}
+
+void VirtualTexture::updateIndirection()
+{
+	// Coarsest level first: tiles not resident point where their parent does
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		const uint32_t width = std::max(tableWidth >> level, 1u), height = std::max(tableHeight >> level, 1u);
+		const uint32_t parentWidth = std::max(tableWidth >> (level + 1), 1u), parentHeight = std::max(tableHeight >> (level + 1), 1u);
+		std::vector<uint8_t>& texels = table[level];
+		for (uint32_t y = 0; y < height; y++)
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint8_t* texel = &texels[((size_t)y * width + x) * 4];
+				const auto found = resident.find(tileKey(level, x, y));
+				if (found != resident.end())
+				{
+					texel[0] = (uint8_t)(found->second % slotsPerSide);
+					texel[1] = (uint8_t)(found->second / slotsPerSide);
+					texel[2] = (uint8_t)level;
+					texel[3] = 255;
+				}
+				else if (level + 1 < levelCount)
+					memcpy(texel, &table[level + 1][((size_t)std::min(y / 2, parentHeight - 1) * parentWidth + std::min(x / 2, parentWidth - 1)) * 4], 4);
+			}
+		glTextureSubImage2D(indirection, level, 0, 0, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, texels.data());
+	}
+	tableDirty = false;
+}
+
+void VirtualTexture::printStats() const
+{
+	printf("Virtual texture %ux%u: %zu of %zu tiles resident, %llu uploaded, %llu evicted, %llu feedbacks read back\n",
+		view.width, view.height, resident.size(), slots.size(), (unsigned long long)tilesUploaded,
+		(unsigned long long)tilesEvicted, (unsigned long long)feedbackRead);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "texturefile.h"
+#include "ThreadPool.h"
+
+// Texture larger than video memory, only the tiles seen being resident:
+// - tiles of kTileSize texels of each level of a cooked texture, cut with a
+//   kTileBorder texel border by worker threads, are held in the slots of a
+//   physical cache texture, the least recently seen being evicted
+// - an indirection texture, one texel per tile of each level, gives the slot
+//   and level to sample: the tile itself once resident, else its closest
+//   resident ancestor (the coarsest tile always is)
+// - a feedback pass draws, at low resolution, the tile each pixel wants,
+//   read back through pixel buffers a few frames later without stalling
+// - the mip tail, from the level held by a single tile down, is a small
+//   mipmapped texture always resident, sampled trilinear past that level
+// Plain GL 4.5, no sparse textures; bilinear within the tiled levels.
+// GL thread only.
+class VirtualTexture
+{
+public:
+	static const uint32_t kTileSize = 128;
+	static const uint32_t kTileBorder = 4; // a block of compressed formats
+	static const uint32_t kSlotSize = kTileSize + 2 * kTileBorder;
+
+	// destroy() must be called while the GL context is current
+	explicit VirtualTexture(ThreadPool& pool = ThreadPool::shared());
+	~VirtualTexture();
+
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	// Tiles are cut from view, which must outlive the texture (in the pack
+	// for instance). The cache holds slotsPerSide squared tiles; feedback is
+	// drawn at a feedbackScale-th of the frame size, in framebuffer pixels.
+	bool create(const TextureView& view, uint32_t slotsPerSide, uint32_t frameWidth, uint32_t frameHeight, uint32_t feedbackScale);
+	void destroy();
+
+	// Resizes the feedback target to follow the frame, once it changed;
+	// feedback not read back yet is dropped
+	void setFrameSize(uint32_t frameWidth, uint32_t frameHeight);
+
+	// Binds the cache, indirection and mip tail textures to these units and
+	// sets the virtual* uniforms of shader (in use), see shadow_mapping.frag
+	void setUniforms(const Shader& shader, GLuint cacheUnit, GLuint indirectionUnit, GLuint tailUnit) const;
+
+	// Same for the feedback shader, virtual_feedback.frag
+	void setFeedbackUniforms(const Shader& shader) const;
+
+	// The scene is drawn with the feedback shader in between
+	void beginFeedback();
+	void endFeedback();
+
+	// Once per frame: reads back the oldest feedback ready, asks the workers
+	// for the tiles it misses and uploads at most byteBudget bytes (a tile
+	// more) of those cut so far; returns the tiles uploaded
+	size_t update(size_t byteBudget);
+
+	size_t residentTiles() const { return resident.size(); }
+	void printStats() const;
+
+private:
+	struct Tile
+	{
+		uint32_t key;
+		std::vector<uint8_t> data;
+	};
+
+	struct Slot
+	{
+		uint32_t key = kNoTile;
+		uint64_t lastSeen = 0; // frame
+	};
+
+	static const uint32_t kNoTile = ~0u;
+	static const unsigned kFeedbackBuffers = 3;
+	static const size_t kMaxLoading = 16;
+
+	static uint32_t tileKey(uint32_t level, uint32_t x, uint32_t y) { return level << 16 | y << 8 | x; }
+
+	void setLevelUniforms(const Shader& shader, float bias) const;
+	void cutTile(uint32_t key, std::vector<uint8_t>& data) const;
+	void uploadTile(uint32_t slot, const Tile& tile);
+	void request(const std::vector<uint32_t>& wanted);
+	void updateIndirection();
+	void destroyFeedback();
+
+	ThreadPool& pool;
+	TextureView view;
+	uint32_t levelCount = 0;     // of the indirection texture, its last level one tile
+	uint32_t tableWidth = 0;     // indirection texels of level 0, a power of two
+	uint32_t tableHeight = 0;
+	uint32_t slotsPerSide = 0;
+	size_t tileBytes = 0;
+	GLuint cache = 0;
+	GLuint indirection = 0;
+	GLuint tail = 0;
+
+	std::vector<Slot> slots;
+	std::unordered_map<uint32_t, uint32_t> resident; // tile key to slot
+	std::unordered_set<uint32_t> loading;
+	std::vector<std::vector<uint8_t>> table;          // RGBA8UI texels of each indirection level
+	bool tableDirty = true;
+	uint64_t frame = 1;
+
+	uint32_t frameWidth = 0;
+	uint32_t frameHeight = 0;
+	uint32_t feedbackScale = 1;
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+	uint32_t feedbackWidth = 0;
+	uint32_t feedbackHeight = 0;
+	float lodBias = 0.f;
+	GLuint readBuffers[kFeedbackBuffers] = {};
+	GLsync fences[kFeedbackBuffers] = {};
+	unsigned nextFeedback = 0;
+	GLint savedViewport[4] = {};
+	GLfloat savedClearColor[4] = {};
+
+	std::vector<std::future<void>> jobs;
+	std::mutex mutex;
+	std::vector<Tile> cut; // waiting for the GL thread
+
+	uint64_t tilesUploaded = 0;
+	uint64_t tilesEvicted = 0;
+	uint64_t feedbackRead = 0;
+};
@@ -0,0 +1,542 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "bcn.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BCN_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const size_t kBlockRowsPerJob = 8;
+const int kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Channels counted in the error of a palette entry
+const unsigned kRGB = 7, kAlpha = 8, kRGBA = 15;
+
+// Texels of a block widened to 16 bits, zero in the channels left out
+struct BlockTexels
+{
+	alignas(16) int16_t values[16][4];
+};
+
+BlockTexels loadTexels(const uint8_t block[64], unsigned channels)
+{
+	BlockTexels texels;
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			texels.values[i][c] = channels >> c & 1 ? block[i * 4 + c] : 0;
+	return texels;
+}
+
+// Index of the closest palette entry for every texel, the first one on ties;
+// returns the summed squared error. Palettes hold zero in the channels the
+// texels left out.
+uint32_t selectIndices(const BlockTexels& texels, const int16_t (*palette)[4], int count, uint8_t indices[16])
+{
+#ifdef BCN_SSE
+	__m128i rows[8];
+	for (int i = 0; i < 8; i++)
+		rows[i] = _mm_load_si128((const __m128i*)texels.values[i * 2]);
+	__m128i best[4], bestIndex[4];
+	for (int q = 0; q < 4; q++)
+	{
+		best[q] = _mm_set1_epi32(INT_MAX);
+		bestIndex[q] = _mm_setzero_si128();
+	}
+	for (int p = 0; p < count; p++)
+	{
+		__m128i entry = _mm_loadl_epi64((const __m128i*)palette[p]);
+		entry = _mm_unpacklo_epi64(entry, entry);
+		const __m128i index = _mm_set1_epi32(p);
+		for (int q = 0; q < 4; q++)
+		{
+			// Two texels a row, squared differences summed by pairs of channels
+			const __m128i d0 = _mm_sub_epi16(rows[q * 2], entry), d1 = _mm_sub_epi16(rows[q * 2 + 1], entry);
+			const __m128 s0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0)), s1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+			const __m128i error = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))),
+				_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))));
+			const __m128i better = _mm_cmplt_epi32(error, best[q]);
+			best[q] = _mm_or_si128(_mm_and_si128(better, error), _mm_andnot_si128(better, best[q]));
+			bestIndex[q] = _mm_or_si128(_mm_and_si128(better, index), _mm_andnot_si128(better, bestIndex[q]));
+		}
+	}
+	alignas(16) uint32_t errors[16], lanes[16];
+	for (int q = 0; q < 4; q++)
+	{
+		_mm_store_si128((__m128i*)&errors[q * 4], best[q]);
+		_mm_store_si128((__m128i*)&lanes[q * 4], bestIndex[q]);
+	}
+	uint32_t total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		indices[i] = (uint8_t)lanes[i];
+		total += errors[i];
+	}
+	return total;
+#else
+	uint32_t total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestError = INT_MAX;
+		for (int p = 0; p < count; p++)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				const int d = texels.values[i][c] - palette[p][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				best = p;
+				bestError = error;
+			}
+		}
+		indices[i] = (uint8_t)best;
+		total += bestError;
+	}
+	return total;
+#endif
+}
+
+inline uint16_t pack565(int r, int g, int b)
+{
+	return (uint16_t)((r * 31 + 127) / 255 << 11 | (g * 63 + 127) / 255 << 5 | (b * 31 + 127) / 255);
+}
+
+inline void unpack565(uint16_t c, int rgb[3])
+{
+	const int r = c >> 11, g = c >> 5 & 63, b = c & 31;
+	rgb[0] = r << 3 | r >> 2;
+	rgb[1] = g << 2 | g >> 4;
+	rgb[2] = b << 3 | b >> 2;
+}
+
+// 16 RGBA texels of the block at (bx, by), clamped to the image
+void fetchBlock(const ImageLevel& level, uint32_t bx, uint32_t by, uint8_t block[64])
+{
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		const uint32_t sy = std::min(by * 4 + y, level.height - 1);
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			const uint32_t sx = std::min(bx * 4 + x, level.width - 1);
+			memcpy(block + (y * 4 + x) * 4, &level.pixels[((size_t)sy * level.width + sx) * 4], 4);
+		}
+	}
+}
+
+void encodeColors(const uint8_t block[64], uint8_t out[8])
+{
+	int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 }, mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			low[c] = std::min<int>(low[c], block[i * 4 + c]);
+			high[c] = std::max<int>(high[c], block[i * 4 + c]);
+			mean[c] += block[i * 4 + c];
+		}
+	}
+
+	// The box diagonal follows red; green and blue flip when they decrease with it
+	int covariance[3] = { 1, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		const int r = block[i * 4] * 16 - mean[0];
+		covariance[1] += r * (block[i * 4 + 1] * 16 - mean[1]);
+		covariance[2] += r * (block[i * 4 + 2] * 16 - mean[2]);
+	}
+
+	int ends[2][3];
+	for (int c = 0; c < 3; c++)
+	{
+		const int inset = (high[c] - low[c]) >> 4;
+		ends[0][c] = high[c] - inset;
+		ends[1][c] = low[c] + inset;
+		if (covariance[c] < 0)
+			std::swap(ends[0][c], ends[1][c]);
+	}
+
+	uint16_t c0 = pack565(ends[0][0], ends[0][1], ends[0][2]);
+	uint16_t c1 = pack565(ends[1][0], ends[1][1], ends[1][2]);
+	// c0 > c1 selects the four color mode
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	uint32_t indices = 0;
+	if (c0 != c1)
+	{
+		int ends[2][3];
+		unpack565(c0, ends[0]);
+		unpack565(c1, ends[1]);
+		int16_t palette[4][4] = {};
+		for (int c = 0; c < 3; c++)
+		{
+			palette[0][c] = (int16_t)ends[0][c];
+			palette[1][c] = (int16_t)ends[1][c];
+			palette[2][c] = (int16_t)((2 * ends[0][c] + ends[1][c]) / 3);
+			palette[3][c] = (int16_t)((ends[0][c] + 2 * ends[1][c]) / 3);
+		}
+		uint8_t selected[16];
+		selectIndices(loadTexels(block, kRGB), palette, 4, selected);
+		for (int i = 0; i < 16; i++)
+			indices |= (uint32_t)selected[i] << (i * 2);
+	}
+
+	memcpy(out, &c0, 2);
+	memcpy(out + 2, &c1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+void encodeAlpha(const uint8_t block[64], uint8_t out[8])
+{
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		low = std::min<int>(low, block[i * 4 + 3]);
+		high = std::max<int>(high, block[i * 4 + 3]);
+	}
+
+	// a0 > a1 selects eight interpolated values
+	uint64_t bits = (uint64_t)high | (uint64_t)low << 8;
+	if (high != low)
+	{
+		int16_t palette[8][4] = {};
+		palette[0][3] = (int16_t)high;
+		palette[1][3] = (int16_t)low;
+		for (int p = 1; p < 7; p++)
+			palette[p + 1][3] = (int16_t)(((7 - p) * high + p * low) / 7);
+		uint8_t selected[16];
+		selectIndices(loadTexels(block, kAlpha), palette, 8, selected);
+		for (int i = 0; i < 16; i++)
+			bits |= (uint64_t)selected[i] << (16 + i * 3);
+	}
+	for (int i = 0; i < 8; i++)
+		out[i] = (uint8_t)(bits >> (i * 8));
+}
+
+
+// Mode 6 endpoints: 7 bits per channel and a p-bit, shared by the channels,
+// as their lowest bit. Picks the p-bit closest to value.
+void quantizeEndpoint(const float value[4], int endpoint[4], int& pbit)
+{
+	float bestError = 1e30f;
+	for (int p = 0; p < 2; p++)
+	{
+		int quantized[4];
+		float error = 0.f;
+		for (int c = 0; c < 4; c++)
+		{
+			const int q = std::min(std::max((int)std::lround((value[c] - p) * 0.5f), 0), 127);
+			quantized[c] = q * 2 + p;
+			error += (quantized[c] - value[c]) * (quantized[c] - value[c]);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			pbit = p;
+			memcpy(endpoint, quantized, sizeof(quantized));
+		}
+	}
+}
+
+void bc7Palette(const int ends[2][4], int16_t palette[16][4])
+{
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			palette[i][c] = (int16_t)(((64 - kBC7Weights[i]) * ends[0][c] + kBC7Weights[i] * ends[1][c] + 32) >> 6);
+}
+
+inline void putBits(uint8_t* out, unsigned& position, uint32_t value, unsigned count)
+{
+	for (unsigned i = 0; i < count; i++, position++)
+		out[position >> 3] |= (uint8_t)((value >> i & 1) << (position & 7));
+}
+
+inline uint32_t getBits(const uint8_t* in, unsigned& position, unsigned count)
+{
+	uint32_t value = 0;
+	for (unsigned i = 0; i < count; i++, position++)
+		value |= (uint32_t)(in[position >> 3] >> (position & 7) & 1) << i;
+	return value;
+}
+
+void encodeBC7(const uint8_t block[64], uint8_t out[16])
+{
+	const BlockTexels texels = loadTexels(block, kRGBA);
+
+	// Principal axis of the texels by power iteration on their covariance
+	float mean[4] = {};
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			mean[c] += texels.values[i][c] / 16.f;
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < 4; a++)
+			for (int b = 0; b < 4; b++)
+				covariance[a][b] += (texels.values[i][a] - mean[a]) * (texels.values[i][b] - mean[b]);
+	float axis[4] = { 1.f, 1.f, 1.f, 1.f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {}, length = 0.f;
+		for (int a = 0; a < 4; a++)
+		{
+			for (int b = 0; b < 4; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = std::max(length, std::abs(next[a]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int c = 0; c < 4; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float low = 0.f, high = 0.f, axisLength = 0.f;
+	for (int c = 0; c < 4; c++)
+		axisLength += axis[c] * axis[c];
+	for (int i = 0; i < 16 && axisLength > 0.f; i++)
+	{
+		float t = 0.f;
+		for (int c = 0; c < 4; c++)
+			t += (texels.values[i][c] - mean[c]) * axis[c];
+		low = std::min(low, t / axisLength);
+		high = std::max(high, t / axisLength);
+	}
+	float endpoints[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = std::min(std::max(mean[c] + low * axis[c], 0.f), 255.f);
+		endpoints[1][c] = std::min(std::max(mean[c] + high * axis[c], 0.f), 255.f);
+	}
+
+	// Endpoints refitted to the indices by least squares while the error drops
+	uint32_t bestError = UINT_MAX;
+	int bestEnds[2][4], bestPbits[2];
+	uint8_t bestIndices[16];
+	for (int iteration = 0; iteration < 3; iteration++)
+	{
+		int ends[2][4], pbits[2];
+		quantizeEndpoint(endpoints[0], ends[0], pbits[0]);
+		quantizeEndpoint(endpoints[1], ends[1], pbits[1]);
+		int16_t palette[16][4];
+		bc7Palette(ends, palette);
+		uint8_t indices[16];
+		const uint32_t error = selectIndices(texels, palette, 16, indices);
+		if (error >= bestError)
+			break;
+		bestError = error;
+		memcpy(bestEnds, ends, sizeof(ends));
+		memcpy(bestPbits, pbits, sizeof(pbits));
+		memcpy(bestIndices, indices, sizeof(indices));
+		if (error == 0)
+			break;
+
+		float aa = 0.f, ab = 0.f, bb = 0.f, ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			const float w = kBC7Weights[indices[i]] / 64.f;
+			aa += (1.f - w) * (1.f - w);
+			ab += (1.f - w) * w;
+			bb += w * w;
+			for (int c = 0; c < 4; c++)
+			{
+				ax[c] += (1.f - w) * texels.values[i][c];
+				bx[c] += w * texels.values[i][c];
+			}
+		}
+		const float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+			break;
+		for (int c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.f), 255.f);
+			endpoints[1][c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.f), 255.f);
+		}
+	}
+
+	// The first index drops its top bit, so it must be below 8
+	if (bestIndices[0] >= 8)
+	{
+		std::swap(bestEnds[0], bestEnds[1]);
+		std::swap(bestPbits[0], bestPbits[1]);
+		for (int i = 0; i < 16; i++)
+			bestIndices[i] = 15 - bestIndices[i];
+	}
+
+	memset(out, 0, 16);
+	unsigned position = 0;
+	putBits(out, position, 1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		putBits(out, position, bestEnds[0][c] >> 1, 7);
+		putBits(out, position, bestEnds[1][c] >> 1, 7);
+	}
+	putBits(out, position, bestPbits[0], 1);
+	putBits(out, position, bestPbits[1], 1);
+	for (int i = 0; i < 16; i++)
+		putBits(out, position, bestIndices[i], i == 0 ? 3 : 4);
+}
+
+// BC3 colors always have four of them, BC1 only when c0 > c1 (else the
+// fourth is black; alpha is left to 255 as in GL's RGB variant)
+void decodeColors(const uint8_t in[8], uint8_t block[64], bool bc3)
+{
+	uint16_t c0, c1;
+	uint32_t indices;
+	memcpy(&c0, in, 2);
+	memcpy(&c1, in + 2, 2);
+	memcpy(&indices, in + 4, 4);
+	const bool fourColors = bc3 || c0 > c1;
+	int palette[4][3];
+	unpack565(c0, palette[0]);
+	unpack565(c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = fourColors ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+		palette[3][c] = fourColors ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			block[i * 4 + c] = (uint8_t)palette[indices >> (i * 2) & 3][c];
+		if (!bc3)
+			block[i * 4 + 3] = 255;
+	}
+}
+
+void decodeAlpha(const uint8_t in[8], uint8_t block[64])
+{
+	uint64_t bits = 0;
+	for (int i = 0; i < 8; i++)
+		bits |= (uint64_t)in[i] << (i * 8);
+	const int a0 = in[0], a1 = in[1];
+	int palette[8] = { a0, a1 };
+	for (int p = 1; p < 7; p++)
+		palette[p + 1] = a0 > a1 ? ((7 - p) * a0 + p * a1) / 7 : p < 5 ? ((5 - p) * a0 + p * a1) / 5 : p == 5 ? 0 : 255;
+	for (int i = 0; i < 16; i++)
+		block[i * 4 + 3] = (uint8_t)palette[bits >> (16 + i * 3) & 7];
+}
+
+void decodeBC7(const uint8_t in[16], uint8_t block[64])
+{
+	unsigned position = 0;
+	if (getBits(in, position, 7) != 1 << 6)
+	{
+		memset(block, 0, 64);
+		return;
+	}
+	int ends[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		ends[0][c] = getBits(in, position, 7) << 1;
+		ends[1][c] = getBits(in, position, 7) << 1;
+	}
+	const uint32_t p0 = getBits(in, position, 1), p1 = getBits(in, position, 1);
+	for (int c = 0; c < 4; c++)
+	{
+		ends[0][c] |= p0;
+		ends[1][c] |= p1;
+	}
+	int16_t palette[16][4];
+	bc7Palette(ends, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		const uint32_t index = getBits(in, position, i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; c++)
+			block[i * 4 + c] = (uint8_t)palette[index][c];
+	}
+}
+}
+
+size_t blockCompressedSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+	const size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (format == BlockFormat::BC1 ? 8 : 16);
+}
+
+std::vector<uint8_t> compressBlocks(const ImageLevel& level, BlockFormat format)
+{
+	std::vector<uint8_t> result(blockCompressedSize(format, level.width, level.height));
+	const uint32_t blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+	const size_t blockSize = format == BlockFormat::BC1 ? 8 : 16;
+	ThreadPool::shared().parallelFor((blocksY + kBlockRowsPerJob - 1) / kBlockRowsPerJob, [&](size_t job)
+	{
+		const uint32_t lastRow = std::min<uint32_t>((uint32_t)((job + 1) * kBlockRowsPerJob), blocksY);
+		uint8_t block[64];
+		for (uint32_t by = (uint32_t)(job * kBlockRowsPerJob); by < lastRow; by++)
+		{
+			uint8_t* out = result.data() + (size_t)by * blocksX * blockSize;
+			for (uint32_t bx = 0; bx < blocksX; bx++, out += blockSize)
+			{
+				fetchBlock(level, bx, by, block);
+				if (format == BlockFormat::BC7)
+					encodeBC7(block, out);
+				else if (format == BlockFormat::BC3)
+				{
+					encodeAlpha(block, out);
+					encodeColors(block, out + 8);
+				}
+				else
+					encodeColors(block, out);
+			}
+		}
+	});
+	return result;
+}
+
+ImageLevel decompressBlocks(const uint8_t* blocks, BlockFormat format, uint32_t width, uint32_t height)
+{
+	ImageLevel level;
+	level.width = width;
+	level.height = height;
+	level.pixels.resize((size_t)width * height * 4);
+	const uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	const size_t blockSize = format == BlockFormat::BC1 ? 8 : 16;
+	uint8_t block[64];
+	for (uint32_t by = 0; by < blocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++, blocks += blockSize)
+		{
+			if (format == BlockFormat::BC7)
+				decodeBC7(blocks, block);
+			else if (format == BlockFormat::BC3)
+			{
+				decodeAlpha(blocks, block);
+				decodeColors(blocks + 8, block, true);
+			}
+			else
+				decodeColors(blocks, block, false);
+
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				const uint32_t columns = std::min(4u, width - bx * 4);
+				memcpy(&level.pixels[((size_t)(by * 4 + y) * width + bx * 4) * 4], block + y * 16, columns * 4);
+			}
+		}
+	}
+	return level;
+}
+
+double computePsnr(const ImageLevel& a, const ImageLevel& b, bool withAlpha)
+{
+	const size_t texels = std::min(a.pixels.size(), b.pixels.size()) / 4;
+	const int channels = withAlpha ? 4 : 3;
+	double error = 0.0;
+	for (size_t i = 0; i < texels; i++)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			const double d = (double)a.pixels[i * 4 + c] - b.pixels[i * 4 + c];
+			error += d * d;
+		}
+	}
+	const double mse = error / std::max<double>(1.0, (double)texels * channels);
+	return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
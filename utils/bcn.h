@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mipmap.h"
+
+// Block formats: 4x4 texel blocks of 8 bytes (BC1, opaque S3TC) or 16 bytes
+// (BC3, BC1 colors plus interpolated alpha; BC7, BPTC)
+enum class BlockFormat
+{
+	BC1,
+	BC3,
+	BC7
+};
+
+size_t blockCompressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// Compresses an RGBA8 level in rows of blocks spread over the shared thread
+// pool, edge blocks repeating the last row and column. BC1 endpoints come from
+// the inset bounding box of each block, oriented along the sign of its color
+// covariance. BC7 blocks are all mode 6 (one RGBA line of 16 steps) along the
+// principal axis of the block, refined by least squares. Indices are picked
+// by least error, with SSE2 when available.
+std::vector<uint8_t> compressBlocks(const ImageLevel& level, BlockFormat format);
+
+// Decompresses blocks as compressBlocks writes them (BC7 mode 6 only)
+ImageLevel decompressBlocks(const uint8_t* blocks, BlockFormat format, uint32_t width, uint32_t height);
+
+// Peak signal to noise ratio of b against a, in dB, over RGB or RGBA
+double computePsnr(const ImageLevel& a, const ImageLevel& b, bool withAlpha);
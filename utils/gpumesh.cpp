@@ -0,0 +1,230 @@
+#include <cstddef>
+#include <cstring>
+#include <stdio.h>
+#include <vector>
+
+#include "gpumesh.h"
+#include "quantize.h"
+
+namespace {
+
+struct InterleavedVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+static_assert(sizeof(InterleavedVertex) == 32, "interleaved vertices must stay 32 bytes");
+
+void setAttribute(GLuint vao, GLuint location, GLuint binding, GLint size, GLuint offset, GLenum type = GL_FLOAT, GLboolean normalized = GL_FALSE)
+{
+	glEnableVertexArrayAttrib(vao, location);
+	glVertexArrayAttribFormat(vao, location, size, type, normalized, offset);
+	glVertexArrayAttribBinding(vao, location, binding);
+}
+
+}
+
+const char* layoutName(VertexLayout layout)
+{
+	switch (layout)
+	{
+	case VertexLayout::Interleaved: return "interleaved";
+	case VertexLayout::Quantized: return "quantized";
+	default: return "split";
+	}
+}
+
+size_t GpuMeshData::totalBytes() const
+{
+	size_t total = indices.size;
+	for (const Buffer& buffer : vertexBuffers)
+		total += buffer.size;
+	return total;
+}
+
+GpuMeshData prepareMesh(const MeshView& mesh, VertexLayout layout)
+{
+	GpuMeshData data;
+	data.layout = layout;
+	if (mesh.vertexCount == 0)
+		return data;
+
+	if (mesh.encoded())
+	{
+		if (layout != VertexLayout::Quantized)
+		{
+			printf("Encoded meshes must be decoded for the %s layout\n", layoutName(layout));
+			return data;
+		}
+		data.vertexBuffers[0] = { nullptr, mesh.vertexCount * sizeof(QuantizedVertex), mesh.encodedVertices, mesh.encodedVerticesSize };
+		data.indices = { nullptr, mesh.indexCount * mesh.indexSize, mesh.encodedIndices, mesh.encodedIndicesSize };
+		data.indexType = mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		data.indexCount = mesh.indexCount;
+		data.positionOffset = mesh.bounds.min;
+		data.positionScale = mesh.bounds.max - mesh.bounds.min;
+		data.octNormals = true;
+		return data;
+	}
+
+	if (layout == VertexLayout::Quantized)
+	{
+		std::vector<QuantizedVertex> vertices = quantizeVertices(mesh);
+		data.vertexStorage.resize(vertices.size() * sizeof(QuantizedVertex));
+		memcpy(data.vertexStorage.data(), vertices.data(), data.vertexStorage.size());
+		data.vertexBuffers[0] = { data.vertexStorage.data(), data.vertexStorage.size() };
+
+		data.positionOffset = mesh.bounds.min;
+		data.positionScale = mesh.bounds.max - mesh.bounds.min;
+		data.octNormals = true;
+	}
+	else if (layout == VertexLayout::Interleaved)
+	{
+		data.vertexStorage.resize(mesh.vertexCount * sizeof(InterleavedVertex));
+		InterleavedVertex* vertices = (InterleavedVertex*)data.vertexStorage.data();
+		for (size_t i = 0; i < mesh.vertexCount; i++)
+			vertices[i] = { mesh.positions[i], mesh.normals[i], mesh.uvs[i] };
+		data.vertexBuffers[0] = { data.vertexStorage.data(), data.vertexStorage.size() };
+	}
+	else
+	{
+		data.vertexBuffers[0] = { mesh.positions, mesh.vertexCount * sizeof(glm::vec3) };
+		data.vertexBuffers[1] = { mesh.normals, mesh.vertexCount * sizeof(glm::vec3) };
+		data.vertexBuffers[2] = { mesh.uvs, mesh.vertexCount * sizeof(glm::vec2) };
+	}
+
+	// 16-bit indices whenever they are enough
+	if (mesh.indexSize == 4 && mesh.vertexCount <= 0x10000)
+	{
+		data.indexStorage = narrowIndices((const uint32_t*)mesh.indices, mesh.indexCount);
+		data.indices = { data.indexStorage.data(), data.indexStorage.size() * sizeof(uint16_t) };
+		data.indexType = GL_UNSIGNED_SHORT;
+	}
+	else
+	{
+		data.indices = { mesh.indices, mesh.indexCount * mesh.indexSize };
+		data.indexType = mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	}
+	data.indexCount = mesh.indexCount;
+	return data;
+}
+
+bool beginDecoding(const GpuMeshData& data, int buffer, StreamDecoder& decoder)
+{
+	if (buffer >= 3)
+		return decoder.beginIndices(data.indices.encoded, data.indices.encodedSize, data.indexCount, data.indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+	const GpuMeshData::Buffer& vertices = data.vertexBuffers[buffer];
+	return decoder.beginVertices(vertices.encoded, vertices.encodedSize, vertices.size / sizeof(QuantizedVertex), sizeof(QuantizedVertex));
+}
+
+GpuMesh createMesh(const GpuMeshData& data, bool fill)
+{
+	GpuMesh gpu;
+	gpu.layout = data.layout;
+	glCreateVertexArrays(1, &gpu.vao);
+
+	// Zero-sized storage is an error, but an empty VAO still draws nothing
+	if (data.vertexBuffers[0].size == 0)
+		return gpu;
+
+	auto createBuffer = [&](int index)
+	{
+		const GpuMeshData::Buffer& buffer = index < 3 ? data.vertexBuffers[index] : data.indices;
+		GLuint name;
+		glCreateBuffers(1, &name);
+		if (!buffer.encoded)
+		{
+			glNamedBufferStorage(name, buffer.size, fill ? buffer.data : nullptr, fill ? 0 : GL_DYNAMIC_STORAGE_BIT);
+			return name;
+		}
+
+		glNamedBufferStorage(name, buffer.size, nullptr, GL_MAP_WRITE_BIT);
+		if (fill)
+		{
+			StreamDecoder decoder;
+			void* mapped = glMapNamedBufferRange(name, 0, buffer.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (!mapped || !beginDecoding(data, index, decoder) || !decoder.decode(mapped, decoder.remaining()))
+				printf("Could not decode mesh buffer\n");
+			glUnmapNamedBuffer(name);
+		}
+		return name;
+	};
+	for (int i = 0; i < 3; i++)
+	{
+		if (data.vertexBuffers[i].size == 0)
+			continue;
+		gpu.vertexBuffers[i] = createBuffer(i);
+		gpu.vertexBytes += data.vertexBuffers[i].size;
+	}
+
+	if (data.layout == VertexLayout::Quantized)
+	{
+		// the normal attribute only gets x and y, z defaults to 0
+		glVertexArrayVertexBuffer(gpu.vao, 0, gpu.vertexBuffers[0], 0, sizeof(QuantizedVertex));
+		setAttribute(gpu.vao, 0, 0, 3, offsetof(QuantizedVertex, position), GL_UNSIGNED_SHORT, GL_TRUE);
+		setAttribute(gpu.vao, 1, 0, 2, offsetof(QuantizedVertex, normal), GL_SHORT, GL_TRUE);
+		setAttribute(gpu.vao, 2, 0, 2, offsetof(QuantizedVertex, uv), GL_HALF_FLOAT);
+	}
+	else if (data.layout == VertexLayout::Interleaved)
+	{
+		glVertexArrayVertexBuffer(gpu.vao, 0, gpu.vertexBuffers[0], 0, sizeof(InterleavedVertex));
+		setAttribute(gpu.vao, 0, 0, 3, offsetof(InterleavedVertex, position));
+		setAttribute(gpu.vao, 1, 0, 3, offsetof(InterleavedVertex, normal));
+		setAttribute(gpu.vao, 2, 0, 2, offsetof(InterleavedVertex, uv));
+	}
+	else
+	{
+		glVertexArrayVertexBuffer(gpu.vao, 0, gpu.vertexBuffers[0], 0, sizeof(glm::vec3));
+		glVertexArrayVertexBuffer(gpu.vao, 1, gpu.vertexBuffers[1], 0, sizeof(glm::vec3));
+		glVertexArrayVertexBuffer(gpu.vao, 2, gpu.vertexBuffers[2], 0, sizeof(glm::vec2));
+		setAttribute(gpu.vao, 0, 0, 3, 0);
+		setAttribute(gpu.vao, 1, 1, 3, 0);
+		setAttribute(gpu.vao, 2, 2, 2, 0);
+	}
+	gpu.positionOffset = data.positionOffset;
+	gpu.positionScale = data.positionScale;
+	gpu.octNormals = data.octNormals;
+
+	gpu.indexBuffer = createBuffer(3);
+	gpu.indexType = data.indexType;
+	gpu.indexCount = (GLsizei)data.indexCount;
+	glVertexArrayElementBuffer(gpu.vao, gpu.indexBuffer);
+	return gpu;
+}
+
+GpuMesh uploadMesh(const MeshView& mesh, VertexLayout layout)
+{
+	return createMesh(prepareMesh(mesh, layout));
+}
+
+void destroyMesh(GpuMesh& mesh)
+{
+	glDeleteVertexArrays(1, &mesh.vao);
+	glDeleteBuffers(3, mesh.vertexBuffers);
+	glDeleteBuffers(1, &mesh.indexBuffer);
+	mesh = GpuMesh();
+}
+
+void drawMesh(const GpuMesh& mesh)
+{
+	glBindVertexArray(mesh.vao);
+	glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, (void*)0);
+	glBindVertexArray(0);
+}
+
+void drawMeshRanges(const GpuMesh& mesh, const std::vector<DrawRange>& ranges)
+{
+	if (ranges.empty())
+		return;
+	const size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+	std::vector<GLsizei> counts(ranges.size());
+	std::vector<const void*> offsets(ranges.size());
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		counts[i] = (GLsizei)ranges[i].indexCount;
+		offsets[i] = (const void*)(ranges[i].firstIndex * indexSize);
+	}
+	glBindVertexArray(mesh.vao);
+	glMultiDrawElements(GL_TRIANGLES, counts.data(), mesh.indexType, offsets.data(), (GLsizei)ranges.size());
+	glBindVertexArray(0);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "mesh.h"
+#include "meshcodec.h"
+#include "meshlet.h"
+
+enum class VertexLayout
+{
+	Split,       // one buffer per attribute stream
+	Interleaved, // position, normal, uv packed in a single 32-byte vertex
+	Quantized    // single 16-byte QuantizedVertex, decoded in the vertex shader
+};
+
+const char* layoutName(VertexLayout layout);
+
+// Mesh resident in immutable GL buffers. Attribute locations follow the
+// shaders: 0 position, 1 normal, 2 uv. Shaders rebuild positions as
+// positionOffset + aPos * positionScale, and decode normals from their
+// octahedral encoding when octNormals is set.
+struct GpuMesh
+{
+	GLuint vao = 0;
+	GLuint vertexBuffers[3] = {};
+	GLuint indexBuffer = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	GLsizei indexCount = 0;
+	VertexLayout layout = VertexLayout::Split;
+	size_t vertexBytes = 0;
+	glm::vec3 positionOffset = glm::vec3(0.f);
+	glm::vec3 positionScale = glm::vec3(1.f);
+	bool octNormals = false;
+};
+
+// Bytes of every buffer of a GpuMesh in a given layout, built without GL so
+// that it can be done on any thread. Streams the layout uses as is point
+// into the MeshView, which must outlive this.
+struct GpuMeshData
+{
+	struct Buffer
+	{
+		const void* data = nullptr;
+		size_t size = 0;
+		const uint8_t* encoded = nullptr; // see meshcodec.h, data is then null
+		size_t encodedSize = 0;
+	};
+
+	VertexLayout layout = VertexLayout::Split;
+	Buffer vertexBuffers[3]; // by binding, unused ones are empty
+	Buffer indices;
+	GLenum indexType = GL_UNSIGNED_INT;
+	size_t indexCount = 0;
+	glm::vec3 positionOffset = glm::vec3(0.f);
+	glm::vec3 positionScale = glm::vec3(1.f);
+	bool octNormals = false;
+
+	// Converted streams the buffers above may point to
+	std::vector<uint8_t> vertexStorage;
+	std::vector<uint16_t> indexStorage;
+
+	GpuMeshData() = default;
+	GpuMeshData(GpuMeshData&&) = default;
+	GpuMeshData& operator=(GpuMeshData&&) = default;
+	GpuMeshData(const GpuMeshData&) = delete;
+	GpuMeshData& operator=(const GpuMeshData&) = delete;
+
+	size_t totalBytes() const;
+};
+
+// Encoded views (compressed mesh files) go as they are in the quantized
+// layout, their buffers being decoded at upload; other layouts need them
+// decoded first (decodeMeshAsset)
+GpuMeshData prepareMesh(const MeshView& mesh, VertexLayout layout);
+
+// Decoder of an encoded buffer of data: vertex buffer 0 to 2 or, past
+// them, the indices
+bool beginDecoding(const GpuMeshData& data, int buffer, StreamDecoder& decoder);
+
+// Creates the vertex array and buffers of data. With fill the buffers get
+// their content right away, otherwise they are left empty and updatable
+// (GL_DYNAMIC_STORAGE_BIT) for glNamedBufferSubData uploads. Encoded buffers
+// are mappable for writing instead, and decoded there.
+GpuMesh createMesh(const GpuMeshData& data, bool fill = true);
+
+GpuMesh uploadMesh(const MeshView& mesh, VertexLayout layout);
+void destroyMesh(GpuMesh& mesh);
+void drawMesh(const GpuMesh& mesh);
+
+// Draws the given index ranges only, in a single glMultiDrawElements
+void drawMeshRanges(const GpuMesh& mesh, const std::vector<DrawRange>& ranges);
@@ -0,0 +1,144 @@
+#include <algorithm>
+
+#include "gputexture.h"
+
+GLenum internalFormat(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TextureFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TextureFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default: return GL_RGBA8;
+	}
+}
+
+GLenum internalFormat(uint32_t channels)
+{
+	static const GLenum formats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	return formats[channels - 1];
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	while ((width | height) >> levels)
+		levels++;
+	return levels;
+}
+
+size_t textureBytes(uint32_t width, uint32_t height, uint32_t levelCount, GLenum internalFormat)
+{
+	size_t bytes = 0;
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		const size_t levelWidth = width >> level ? width >> level : 1;
+		const size_t levelHeight = height >> level ? height >> level : 1;
+		const size_t blocks = ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4);
+		switch (internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: bytes += blocks * 8; break;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: bytes += blocks * 16; break;
+		case GL_R8: bytes += levelWidth * levelHeight; break;
+		case GL_RG8: bytes += levelWidth * levelHeight * 2; break;
+		default: bytes += levelWidth * levelHeight * 4; break; // RGB8 is padded to four bytes by drivers
+		}
+	}
+	return bytes;
+}
+
+GLuint createTextureStorage(const TextureView& view, uint32_t firstLevel)
+{
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, view.levelCount - firstLevel, internalFormat(view.format),
+		std::max(view.width >> firstLevel, 1u), std::max(view.height >> firstLevel, 1u));
+
+	const GLint wrap = view.channels == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
+
+uint32_t levelRowCount(const TextureView& view, uint32_t level)
+{
+	const uint32_t height = std::max(view.height >> level, 1u);
+	return view.format == TextureFormat::RGBA8 ? height : (height + 3) / 4;
+}
+
+void uploadLevelRows(GLuint texture, GLint textureLevel, const TextureView& view, uint32_t level, uint32_t firstRow, uint32_t rowCount)
+{
+	uploadLevelRows(texture, textureLevel, view, level, firstRow, rowCount, view.levels[level]);
+}
+
+void uploadLevelRows(GLuint texture, GLint textureLevel, const TextureView& view, uint32_t level, uint32_t firstRow, uint32_t rowCount,
+	const uint8_t* levelData)
+{
+	const uint32_t width = std::max(view.width >> level, 1u);
+	const uint32_t height = std::max(view.height >> level, 1u);
+	const size_t rowBytes = view.levelSizes[level] / levelRowCount(view, level);
+	const uint8_t* data = levelData + rowBytes * firstRow;
+	if (view.format == TextureFormat::RGBA8)
+		glTextureSubImage2D(texture, textureLevel, 0, firstRow, width, rowCount, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	else
+	{
+		// Blocks rows are 4 texels high but for the last one of small levels
+		const uint32_t y = firstRow * 4;
+		glCompressedTextureSubImage2D(texture, textureLevel, 0, y, width, std::min(rowCount * 4, height - y),
+			internalFormat(view.format), (GLsizei)(rowBytes * rowCount), data);
+	}
+}
+
+GLuint createTexture(const TextureView& view, uint32_t firstLevel)
+{
+	const GLuint texture = createTextureStorage(view, firstLevel);
+	for (uint32_t level = firstLevel; level < view.levelCount; level++)
+		uploadLevelRows(texture, level - firstLevel, view, level, 0, levelRowCount(view, level));
+	return texture;
+}
+
+GLuint createTextureArray(const TextureView& view)
+{
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+	glTextureStorage3D(texture, view.levelCount, internalFormat(view.format), view.width, view.height, view.layerCount);
+	for (uint32_t level = 0; level < view.levelCount; level++)
+	{
+		const uint32_t width = std::max(view.width >> level, 1u);
+		const uint32_t height = std::max(view.height >> level, 1u);
+		if (view.format == TextureFormat::RGBA8)
+			glTextureSubImage3D(texture, level, 0, 0, 0, width, height, view.layerCount, GL_RGBA, GL_UNSIGNED_BYTE, view.levels[level]);
+		else
+			glCompressedTextureSubImage3D(texture, level, 0, 0, 0, width, height, view.layerCount,
+				internalFormat(view.format), (GLsizei)view.levelSizes[level], view.levels[level]);
+	}
+
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
+
+GLuint createTexture(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels)
+{
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, mipLevelCount(width, height), internalFormat(channels), width, height);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(texture, 0, 0, 0, width, height, formats[channels - 1], GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateTextureMipmap(texture);
+
+	const GLint wrap = channels == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "texturefile.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+GLenum internalFormat(TextureFormat format);
+// Of decoded pixels of 1 to 4 channels
+GLenum internalFormat(uint32_t channels);
+
+// Immutable texture holding the levels of a cooked texture from firstLevel
+// down (its level 0 being firstLevel), trilinear, clamped when the source had
+// alpha and repeated otherwise
+GLuint createTexture(const TextureView& view, uint32_t firstLevel = 0);
+
+// Same storage and sampling, left empty
+GLuint createTextureStorage(const TextureView& view, uint32_t firstLevel);
+
+// Rows of a level of view, of texels or of 4x4 blocks when compressed
+uint32_t levelRowCount(const TextureView& view, uint32_t level);
+
+// Uploads rows [firstRow, firstRow + rowCount) of a level of view into
+// textureLevel of texture
+void uploadLevelRows(GLuint texture, GLint textureLevel, const TextureView& view, uint32_t level, uint32_t firstRow, uint32_t rowCount);
+// Same with the level elsewhere: an offset into the pixel unpack buffer
+// bound for instance, see UploadRing
+void uploadLevelRows(GLuint texture, GLint textureLevel, const TextureView& view, uint32_t level, uint32_t firstRow, uint32_t rowCount,
+	const uint8_t* levelData);
+
+// GL_TEXTURE_2D_ARRAY holding every layer of a cooked texture array,
+// trilinear and repeated: the shader wraps or clamps within each texture
+GLuint createTextureArray(const TextureView& view);
+
+// Same from decoded pixels (1 to 4 channels of 8 bits), the mips being
+// generated by GL; pixels may be an offset into the pixel unpack buffer bound
+GLuint createTexture(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels);
+
+// Bytes of video memory a texture of that size and format holds, mips included
+size_t textureBytes(uint32_t width, uint32_t height, uint32_t levelCount, GLenum internalFormat);
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
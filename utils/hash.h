@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Fast non-cryptographic 64-bit hash, used to detect changed source assets.
+// Reads eight bytes at a time, so it stays well ahead of disk throughput.
+inline uint64_t hash64(const void* data, size_t size, uint64_t seed = 0)
+{
+	const uint64_t k0 = 0x9E3779B97F4A7C15ull;
+	const uint64_t k1 = 0xBF58476D1CE4E5B9ull;
+	const uint64_t k2 = 0x94D049BB133111EBull;
+
+	const unsigned char* p = (const unsigned char*)data;
+	uint64_t h = seed ^ (size * k0);
+
+	while (size >= 32)
+	{
+		uint64_t w[4];
+		memcpy(w, p, sizeof(w));
+		h ^= (w[0] * k1) ^ ((w[1] * k2) >> 1) ^ ((w[2] * k1) << 1) ^ (w[3] * k2);
+		h = (h << 27 | h >> 37) * k0;
+		p += 32;
+		size -= 32;
+	}
+	while (size >= 8)
+	{
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		h = ((h ^ (w * k1)) << 31 | (h ^ (w * k1)) >> 33) * k0;
+		p += 8;
+		size -= 8;
+	}
+	if (size)
+	{
+		uint64_t w = 0;
+		memcpy(&w, p, size);
+		h = ((h ^ (w * k2)) << 29 | (h ^ (w * k2)) >> 35) * k0;
+	}
+
+	h ^= h >> 30;
+	h *= k1;
+	h ^= h >> 27;
+	h *= k2;
+	h ^= h >> 31;
+	return h;
+}
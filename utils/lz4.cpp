@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "lz4.h"
+
+namespace {
+
+const size_t kMinMatch = 4;
+const size_t kLastLiterals = 5;  // the block always ends with that many literals
+const size_t kMatchLimit = 12;   // and no match starts in its last 12 bytes
+const size_t kMaxOffset = 65535;
+const unsigned kHashBits = 16;
+
+inline uint32_t read32(const char* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+inline uint32_t hash4(uint32_t value)
+{
+	return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+void writeLength(std::vector<char>& out, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		out.push_back((char)255);
+	out.push_back((char)length);
+}
+
+// One sequence: literals followed by a match, the last one of a block has
+// no match (matchLength 0)
+void writeSequence(std::vector<char>& out, const char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	const size_t extra = matchLength ? matchLength - kMinMatch : 0;
+	out.push_back((char)(std::min<size_t>(literalCount, 15) << 4 | std::min<size_t>(extra, 15)));
+	if (literalCount >= 15)
+		writeLength(out, literalCount - 15);
+	out.insert(out.end(), literals, literals + literalCount);
+	if (matchLength == 0)
+		return;
+	out.push_back((char)(offset & 255));
+	out.push_back((char)(offset >> 8));
+	if (extra >= 15)
+		writeLength(out, extra - 15);
+}
+
+bool readLength(const unsigned char*& p, const unsigned char* end, size_t& length)
+{
+	unsigned char byte;
+	do
+	{
+		if (p == end)
+			return false;
+		byte = *p++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+}
+
+size_t lz4Compress(const char* source, size_t size, std::vector<char>& destination)
+{
+	const size_t start = destination.size();
+	destination.reserve(start + size + size / 255 + 16);
+
+	size_t anchor = 0;
+	if (size > kMatchLimit)
+	{
+		std::vector<uint32_t> table(size_t(1) << kHashBits, 0);
+		const size_t matchStartLimit = size - kMatchLimit;
+		const size_t matchEndLimit = size - kLastLiterals;
+
+		size_t i = 1;
+		while (i < matchStartLimit)
+		{
+			const uint32_t value = read32(source + i);
+			const uint32_t hash = hash4(value);
+			size_t candidate = table[hash];
+			table[hash] = (uint32_t)i;
+
+			if (i - candidate > kMaxOffset || read32(source + candidate) != value)
+			{
+				// Step further the longer nothing matches, so that incompressible
+				// data (already compressed images) goes through quickly
+				i += 1 + ((i - anchor) >> 6);
+				continue;
+			}
+
+			size_t begin = i;
+			while (begin > anchor && candidate > 0 && source[begin - 1] == source[candidate - 1])
+			{
+				begin--;
+				candidate--;
+			}
+			size_t end = i + kMinMatch;
+			while (end < matchEndLimit && source[end] == source[candidate + (end - begin)])
+				end++;
+
+			writeSequence(destination, source + anchor, begin - anchor, begin - candidate, end - begin);
+			anchor = i = end;
+			if (i - 2 < matchStartLimit)
+				table[hash4(read32(source + i - 2))] = (uint32_t)(i - 2);
+		}
+	}
+
+	writeSequence(destination, source + anchor, size - anchor, 0, 0);
+	return destination.size() - start;
+}
+
+bool lz4Decompress(const char* source, size_t sourceSize, char* destination, size_t destinationSize)
+{
+	const unsigned char* p = (const unsigned char*)source;
+	const unsigned char* end = p + sourceSize;
+	char* out = destination;
+	char* const outEnd = destination + destinationSize;
+
+	for (;;)
+	{
+		if (p == end)
+			return false;
+		const unsigned token = *p++;
+
+		size_t literals = token >> 4;
+		if (literals == 15 && !readLength(p, end, literals))
+			return false;
+		if (literals > (size_t)(end - p) || literals > (size_t)(outEnd - out))
+			return false;
+		memcpy(out, p, literals);
+		out += literals;
+		p += literals;
+
+		// The last sequence has no match
+		if (p == end)
+			return out == outEnd;
+
+		if (end - p < 2)
+			return false;
+		const size_t offset = p[0] | (size_t)p[1] << 8;
+		p += 2;
+		if (offset == 0 || offset > (size_t)(out - destination))
+			return false;
+
+		size_t length = token & 15;
+		if (length == 15 && !readLength(p, end, length))
+			return false;
+		length += kMinMatch;
+		if (length > (size_t)(outEnd - out))
+			return false;
+
+		const char* match = out - offset;
+		if (offset >= length)
+			memcpy(out, match, length);
+		else if (offset >= 8)
+		{
+			// Overlapping, but eight bytes at a time never read what they write
+			size_t i = 0;
+			for (; i + 8 <= length; i += 8)
+				memcpy(out + i, match + i, 8);
+			for (; i < length; i++)
+				out[i] = match[i];
+		}
+		else
+		{
+			for (size_t i = 0; i < length; i++)
+				out[i] = match[i];
+		}
+		out += length;
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// LZ4 block format (no frame): greedy matches found through a single hash
+// table, which keeps compression fast and decompression a few memcpy's per
+// sequence. Blocks are compatible with the reference LZ4_decompress_safe.
+
+// Appends the compressed block to destination and returns its size
+size_t lz4Compress(const char* source, size_t size, std::vector<char>& destination);
+
+// A block never decompresses to more than this many times its size: a
+// length byte extends a match by at most 255 bytes
+const size_t kLz4MaxRatio = 255;
+
+// Decompresses a whole block into exactly destinationSize bytes; false on
+// corrupt input, never reading or writing out of bounds
+bool lz4Decompress(const char* source, size_t sourceSize, char* destination, size_t destinationSize);
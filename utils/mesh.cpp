@@ -0,0 +1,62 @@
+#include <cmath>
+
+#include "mesh.h"
+
+Bounds computeBounds(const std::vector<glm::vec3>& positions)
+{
+	Bounds bounds;
+	if (positions.empty())
+		return bounds;
+	bounds.min = bounds.max = positions[0];
+	for (const glm::vec3& p : positions)
+	{
+		bounds.min = glm::min(bounds.min, p);
+		bounds.max = glm::max(bounds.max, p);
+	}
+	return bounds;
+}
+
+MeshView viewMesh(const Mesh& mesh, const Bounds& bounds)
+{
+	MeshView view;
+	view.positions = mesh.positions.data();
+	view.normals = mesh.normals.data();
+	view.uvs = mesh.uvs.data();
+	view.tangents = mesh.tangents.empty() ? nullptr : mesh.tangents.data();
+	view.vertexCount = mesh.vertexCount();
+	view.indices = mesh.indices.data();
+	view.indexCount = mesh.indices.size();
+	view.indexSize = 4;
+	view.meshlets = mesh.meshlets.data();
+	view.meshletCount = mesh.meshlets.size();
+	view.lods = mesh.lods.data();
+	view.lodCount = mesh.lods.size();
+	view.bounds = bounds;
+	return view;
+}
+
+std::vector<uint16_t> narrowIndices(const uint32_t* indices, size_t count)
+{
+	std::vector<uint16_t> narrow(count);
+	for (size_t i = 0; i < count; i++)
+		narrow[i] = (uint16_t)indices[i];
+	return narrow;
+}
+
+float uvDensity(const MeshView& view)
+{
+	if (!view.positions || !view.uvs || !view.indices)
+		return 0.f;
+	const size_t first = view.lodCount > 0 ? view.lods[0].indexOffset : 0;
+	const size_t end = view.lodCount > 0 ? first + view.lods[0].indexCount : view.indexCount;
+	auto index = [&](size_t i) { return view.indexSize == 2 ? ((const uint16_t*)view.indices)[i] : ((const uint32_t*)view.indices)[i]; };
+	double area = 0.0, uvArea = 0.0;
+	for (size_t i = first; i + 2 < end; i += 3)
+	{
+		const uint32_t a = index(i), b = index(i + 1), c = index(i + 2);
+		area += glm::length(glm::cross(view.positions[b] - view.positions[a], view.positions[c] - view.positions[a]));
+		const glm::vec2 u = view.uvs[b] - view.uvs[a], v = view.uvs[c] - view.uvs[a];
+		uvArea += std::abs(u.x * v.y - u.y * v.x);
+	}
+	return area > 0.0 ? (float)std::sqrt(uvArea / area) : 0.f;
+}
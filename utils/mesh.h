@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Bounds
+{
+	glm::vec3 min = glm::vec3(0.f);
+	glm::vec3 max = glm::vec3(0.f);
+};
+
+// Run of at most kMeshletMaxTriangles consecutive triangles of a mesh using at
+// most kMeshletMaxVertices vertices, with what is needed to cull it as a whole:
+// a bounding sphere and a cone containing its triangle normals. The cluster
+// faces away from any eye for which
+// dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius,
+// a coneCutoff of 1 disables the test.
+struct Meshlet
+{
+	uint32_t indexOffset;
+	uint32_t triangleCount;
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+static_assert(sizeof(Meshlet) == 40, "meshlets are stored as is in mesh files");
+
+const size_t kMeshletMaxVertices = 64;
+const size_t kMeshletMaxTriangles = 124;
+
+// Level of detail: a range of indices over the shared vertices, and how far
+// (in model units) its surface may be from the full resolution one
+struct MeshLod
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float error;
+};
+static_assert(sizeof(MeshLod) == 12, "levels of detail are stored as is in mesh files");
+
+const size_t kMaxMeshLods = 6;
+
+// Indexed triangle mesh: every stream holds one entry per unique vertex
+// and each triangle is three consecutive entries of indices.
+struct Mesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec4> tangents; // optional: xyz tangent, w bitangent sign
+	std::vector<uint32_t> indices;
+	std::vector<Meshlet> meshlets; // optional, covers the first level of detail in order when present
+	std::vector<MeshLod> lods;     // optional, split indices in levels of detail, finest first
+
+	size_t vertexCount() const { return positions.size(); }
+	size_t triangleCount() const { return indices.size() / 3; }
+
+	// Width in bytes of the GPU index buffer: 16 bits whenever they are enough
+	unsigned indexSize() const { return positions.size() <= 0x10000 ? 2 : 4; }
+};
+
+// Non-owning view of the streams of a mesh, which may live in a Mesh or
+// directly in a mapped cache file. indices are indexSize bytes wide.
+struct MeshView
+{
+	const glm::vec3* positions = nullptr;
+	const glm::vec3* normals = nullptr;
+	const glm::vec2* uvs = nullptr;
+	const glm::vec4* tangents = nullptr; // may be null
+	size_t vertexCount = 0;
+	const void* indices = nullptr;
+	size_t indexCount = 0;
+	unsigned indexSize = 4;
+	const Meshlet* meshlets = nullptr;
+	size_t meshletCount = 0;
+	const MeshLod* lods = nullptr;
+	size_t lodCount = 0;
+	Bounds bounds;
+
+	// Compressed mesh files carry their quantized vertices (QuantizedVertex),
+	// tangents (QuantizedTangent) and indices encoded instead (see
+	// meshcodec.h); positions, normals, uvs, tangents and indices are then null
+	const uint8_t* encodedVertices = nullptr;
+	size_t encodedVerticesSize = 0;
+	const uint8_t* encodedTangents = nullptr; // may be null
+	size_t encodedTangentsSize = 0;
+	const uint8_t* encodedIndices = nullptr;
+	size_t encodedIndicesSize = 0;
+
+	bool encoded() const { return encodedVertices != nullptr; }
+};
+
+Bounds computeBounds(const std::vector<glm::vec3>& positions);
+
+MeshView viewMesh(const Mesh& mesh, const Bounds& bounds);
+
+// Copies indices into a 16-bit buffer, for meshes of at most 65536 vertices
+std::vector<uint16_t> narrowIndices(const uint32_t* indices, size_t count);
+
+// Uv distance per model unit, averaged by area over the triangles of the
+// first level of detail; 0 for encoded views or without uvs
+float uvDensity(const MeshView& view);
@@ -0,0 +1,327 @@
+#include <cstddef>
+#include <cstring>
+#include <stdio.h>
+#include <string>
+#include <filesystem>
+
+#include "meshcache.h"
+#include "meshcodec.h"
+#include "meshopt.h"
+#include "plyloader.h"
+#include "quantize.h"
+#include "simplify.h"
+#include "tangentspace.h"
+#include "Timer.h"
+
+namespace {
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool writePadded(FILE* file, const void* data, size_t size, uint64_t& offset)
+{
+	static const char zeros[16] = {};
+	const uint64_t aligned = alignUp(offset, 16);
+	if (aligned != offset && fwrite(zeros, 1, (size_t)(aligned - offset), file) != aligned - offset)
+		return false;
+	offset = aligned + size;
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+bool isPLY(const char* path)
+{
+	const size_t length = strlen(path);
+	return length >= 4 && (strcmp(path + length - 4, ".ply") == 0 || strcmp(path + length - 4, ".PLY") == 0);
+}
+
+// Written so that corrupt offsets cannot wrap around
+inline bool fits(uint64_t offset, uint64_t size, size_t fileSize)
+{
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+bool isValid(const MeshFileHeader& header, size_t fileSize)
+{
+	if (fileSize < sizeof(MeshFileHeader) || memcmp(header.magic, "GMSH", 4) != 0 || header.version != kMeshFileVersion)
+		return false;
+	if ((header.indexSize != 2 && header.indexSize != 4) || header.lodCount > kMaxMeshLods)
+		return false;
+	if (!fits(header.meshletsOffset, (uint64_t)header.meshletCount * sizeof(Meshlet), fileSize)
+		|| !fits(header.lodsOffset, (uint64_t)header.lodCount * sizeof(MeshLod), fileSize))
+		return false;
+	if (header.encoding == MeshEncoded)
+		return fits(header.encodedVerticesOffset, header.encodedVerticesSize, fileSize)
+			&& fits(header.encodedTangentsOffset, header.encodedTangentsSize, fileSize)
+			&& fits(header.encodedIndicesOffset, header.encodedIndicesSize, fileSize);
+	if (header.encoding != MeshRaw)
+		return false;
+
+	const uint64_t vertices = header.vertexCount;
+	return fits(header.positionsOffset, vertices * sizeof(glm::vec3), fileSize)
+		&& fits(header.normalsOffset, vertices * sizeof(glm::vec3), fileSize)
+		&& fits(header.uvsOffset, vertices * sizeof(glm::vec2), fileSize)
+		&& fits(header.indicesOffset, (uint64_t)header.indexCount * header.indexSize, fileSize)
+		&& fits(header.tangentsOffset, header.tangentsOffset ? vertices * sizeof(glm::vec4) : 0, fileSize);
+}
+
+// Levels of detail and meshlets have to stay inside the indices, which have
+// to stay inside the vertices
+bool rangesValid(const MeshView& view)
+{
+	for (size_t i = 0; i < view.lodCount; i++)
+		if (view.lods[i].indexOffset > view.indexCount || view.lods[i].indexCount > view.indexCount - view.lods[i].indexOffset)
+			return false;
+	for (size_t i = 0; i < view.meshletCount; i++)
+		if (view.meshlets[i].indexOffset > view.indexCount
+			|| (uint64_t)view.meshlets[i].triangleCount * 3 > view.indexCount - view.meshlets[i].indexOffset)
+			return false;
+	return true;
+}
+
+bool indicesValid(const MeshView& view)
+{
+	for (size_t i = 0; i < view.indexCount; i++)
+	{
+		const uint32_t index = view.indexSize == 2 ? ((const uint16_t*)view.indices)[i] : ((const uint32_t*)view.indices)[i];
+		if (index >= view.vertexCount)
+			return false;
+	}
+	return true;
+}
+
+}
+
+bool buildMesh(const char* path, Mesh& mesh, const ObjLoadOptions& options)
+{
+	if (!(isPLY(path) ? loadPLY(path, mesh) : loadOBJ(path, mesh, options)))
+		return false;
+	computeTangents(mesh);
+	optimizeMesh(mesh);
+	buildLods(mesh);
+	return true;
+}
+
+bool writeMeshFile(const char* path, const MeshView& view, const SourceInfo& source, bool encode)
+{
+	const unsigned indexSize = view.vertexCount <= 0x10000 ? 2 : 4;
+	std::vector<uint16_t> narrow;
+	const void* indices = view.indices;
+	if (indexSize == 2 && view.indexSize == 4)
+	{
+		narrow = narrowIndices((const uint32_t*)view.indices, view.indexCount);
+		indices = narrow.data();
+	}
+
+	MeshFileHeader header = {};
+	memcpy(header.magic, "GMSH", 4);
+	header.version = kMeshFileVersion;
+	header.sourceSize = source.size;
+	header.sourceTime = source.time;
+	header.sourceHash = source.hash;
+	header.vertexCount = (uint32_t)view.vertexCount;
+	header.indexCount = (uint32_t)view.indexCount;
+	header.indexSize = indexSize;
+	header.meshletCount = (uint32_t)view.meshletCount;
+	header.lodCount = (uint32_t)view.lodCount;
+	memcpy(header.boundsMin, &view.bounds.min, sizeof(header.boundsMin));
+	memcpy(header.boundsMax, &view.bounds.max, sizeof(header.boundsMax));
+
+	// Encoded files put their streams in place of the raw ones, which are empty
+	std::vector<uint8_t> encodedVertices, encodedTangents, encodedIndices;
+	const bool raw = !encode;
+	if (encode)
+	{
+		const std::vector<QuantizedVertex> vertices = quantizeVertices(view);
+		encodeVertexBuffer(vertices.data(), vertices.size(), sizeof(QuantizedVertex), encodedVertices);
+		if (view.tangents)
+		{
+			const std::vector<QuantizedTangent> tangents = quantizeTangents(view);
+			encodeVertexBuffer(tangents.data(), tangents.size(), sizeof(QuantizedTangent), encodedTangents);
+		}
+		encodeIndexBuffer(indices, view.indexCount, indexSize, encodedIndices);
+		header.encoding = MeshEncoded;
+	}
+
+	const uint64_t positionsSize = raw ? view.vertexCount * sizeof(glm::vec3) : 0;
+	const uint64_t uvsSize = raw ? view.vertexCount * sizeof(glm::vec2) : 0;
+	const uint64_t indicesSize = raw ? view.indexCount * indexSize : 0;
+	const uint64_t tangentsSize = raw && view.tangents ? view.vertexCount * sizeof(glm::vec4) : 0;
+	header.positionsOffset = alignUp(sizeof(MeshFileHeader), 16);
+	header.normalsOffset = alignUp(header.positionsOffset + positionsSize, 16);
+	header.uvsOffset = alignUp(header.normalsOffset + positionsSize, 16);
+	header.indicesOffset = alignUp(header.uvsOffset + uvsSize, 16);
+	header.meshletsOffset = alignUp(header.indicesOffset + indicesSize, 16);
+	header.lodsOffset = alignUp(header.meshletsOffset + view.meshletCount * sizeof(Meshlet), 16);
+	uint64_t end = header.lodsOffset + view.lodCount * sizeof(MeshLod);
+	if (tangentsSize)
+		end = (header.tangentsOffset = alignUp(end, 16)) + tangentsSize;
+	if (encode)
+	{
+		header.encodedVerticesOffset = alignUp(end, 16);
+		header.encodedVerticesSize = encodedVertices.size();
+		end = header.encodedVerticesOffset + header.encodedVerticesSize;
+		if (view.tangents)
+		{
+			header.encodedTangentsOffset = alignUp(end, 16);
+			header.encodedTangentsSize = encodedTangents.size();
+			end = header.encodedTangentsOffset + header.encodedTangentsSize;
+		}
+		header.encodedIndicesOffset = alignUp(end, 16);
+		header.encodedIndicesSize = encodedIndices.size();
+	}
+
+	// Write next to the destination and rename, so that a crash or a
+	// concurrent reader never sees a half-written file
+	const std::string temporary = std::string(path) + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+
+	uint64_t offset = 0;
+	bool ok = writePadded(file, &header, sizeof(header), offset)
+		&& writePadded(file, view.positions, (size_t)positionsSize, offset)
+		&& writePadded(file, view.normals, (size_t)positionsSize, offset)
+		&& writePadded(file, view.uvs, (size_t)uvsSize, offset)
+		&& writePadded(file, indices, (size_t)indicesSize, offset)
+		&& writePadded(file, view.meshlets, view.meshletCount * sizeof(Meshlet), offset)
+		&& writePadded(file, view.lods, view.lodCount * sizeof(MeshLod), offset)
+		&& writePadded(file, view.tangents, (size_t)tangentsSize, offset)
+		&& writePadded(file, encodedVertices.data(), encodedVertices.size(), offset)
+		&& writePadded(file, encodedTangents.data(), encodedTangents.size(), offset)
+		&& writePadded(file, encodedIndices.data(), encodedIndices.size(), offset);
+	ok = fclose(file) == 0 && ok;
+
+	std::error_code error;
+	if (ok)
+		std::filesystem::rename(temporary, path, error);
+	if (!ok || error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+bool mapMeshFile(const char* path, MappedFile& file, MeshView& view, MeshFileHeader& header)
+{
+	if (!file.open(path))
+		return false;
+	if (!viewMeshFile(file.data(), file.size(), view, header))
+	{
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+bool viewMeshFile(const char* data, size_t size, MeshView& view, MeshFileHeader& header)
+{
+	if (size < sizeof(MeshFileHeader))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (!isValid(header, size))
+		return false;
+
+	const char* base = data;
+	view = MeshView();
+	if (header.encoding == MeshEncoded)
+	{
+		view.encodedVertices = (const uint8_t*)(base + header.encodedVerticesOffset);
+		view.encodedVerticesSize = header.encodedVerticesSize;
+		view.encodedTangents = header.encodedTangentsOffset ? (const uint8_t*)(base + header.encodedTangentsOffset) : nullptr;
+		view.encodedTangentsSize = header.encodedTangentsSize;
+		view.encodedIndices = (const uint8_t*)(base + header.encodedIndicesOffset);
+		view.encodedIndicesSize = header.encodedIndicesSize;
+	}
+	else
+	{
+		view.positions = (const glm::vec3*)(base + header.positionsOffset);
+		view.normals = (const glm::vec3*)(base + header.normalsOffset);
+		view.uvs = (const glm::vec2*)(base + header.uvsOffset);
+		view.tangents = header.tangentsOffset ? (const glm::vec4*)(base + header.tangentsOffset) : nullptr;
+		view.indices = base + header.indicesOffset;
+	}
+	view.vertexCount = header.vertexCount;
+	view.indexCount = header.indexCount;
+	view.indexSize = header.indexSize;
+	view.meshlets = (const Meshlet*)(base + header.meshletsOffset);
+	view.meshletCount = header.meshletCount;
+	view.lods = (const MeshLod*)(base + header.lodsOffset);
+	view.lodCount = header.lodCount;
+	memcpy(&view.bounds.min, header.boundsMin, sizeof(header.boundsMin));
+	memcpy(&view.bounds.max, header.boundsMax, sizeof(header.boundsMax));
+	// Encoded indices are checked once decoded (decodeMeshAsset)
+	return rangesValid(view) && (view.encoded() || indicesValid(view));
+}
+
+bool loadMesh(const char* path, MeshAsset& asset, const ObjLoadOptions& options)
+{
+	Timer timer;
+	const std::string cachePath = std::string(path) + ".mesh";
+
+	SourceInfo source;
+	if (!getSourceInfo(path, source, false))
+	{
+		printf("Impossible to open the file %s\n", path);
+		return false;
+	}
+
+	MeshFileHeader header;
+	if (mapMeshFile(cachePath.c_str(), asset.file, asset.view, header) && header.sourceSize == source.size)
+	{
+		bool fresh = header.sourceTime == source.time;
+		if (!fresh && getSourceInfo(path, source, true) && header.sourceHash == source.hash)
+		{
+			// Touched but not modified: record the new time so the next run
+			// can skip hashing again
+			asset.file.close();
+			FILE* file = fopen(cachePath.c_str(), "r+b");
+			if (file)
+			{
+				fseek(file, offsetof(MeshFileHeader, sourceTime), SEEK_SET);
+				fwrite(&source.time, sizeof(source.time), 1, file);
+				fclose(file);
+			}
+			fresh = mapMeshFile(cachePath.c_str(), asset.file, asset.view, header);
+		}
+
+		if (fresh && !decodeMeshAsset(asset))
+		{
+			printf("Corrupt mesh cache %s\n", cachePath.c_str());
+			fresh = false;
+		}
+		if (fresh)
+		{
+			printf("Mapped mesh cache %s (%u vertices, %u triangles, %u meshlets, %u levels of detail) in %.2f ms\n",
+				cachePath.c_str(), header.vertexCount, asset.view.lodCount ? asset.view.lods[0].indexCount / 3 : header.indexCount / 3,
+				header.meshletCount, header.lodCount, timer.elapsed() * 1000.f);
+			return true;
+		}
+	}
+	asset.file.close();
+
+	// Missing or stale cache: parse the source and write a new one
+	if (!buildMesh(path, asset.mesh, options))
+		return false;
+	asset.view = viewMesh(asset.mesh, computeBounds(asset.mesh.positions));
+
+	if (!source.hash && !getSourceInfo(path, source, true))
+		return false;
+	if (!writeMeshFile(cachePath.c_str(), asset.view, source))
+		printf("Could not write mesh cache %s\n", cachePath.c_str());
+
+	printf("Built mesh cache %s in %.2f ms\n", cachePath.c_str(), timer.elapsed() * 1000.f);
+	return true;
+}
+
+bool decodeMeshAsset(MeshAsset& asset)
+{
+	if (!asset.view.encoded())
+		return true;
+	if (!decodeMesh(asset.view, asset.mesh))
+		return false;
+	asset.view = viewMesh(asset.mesh, asset.view.bounds);
+	return indicesValid(asset.view);
+}
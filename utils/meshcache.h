@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "mesh.h"
+#include "objloader.hpp"
+#include "sourceinfo.h"
+
+// Binary mesh file, little-endian. Streams follow the header, each one
+// starting on a 16-byte boundary, so a mapped file can be handed to the GPU
+// as is. Encoded files (MeshEncoded) trade that for size: they hold the
+// quantized vertices, tangents and indices through meshcodec.h instead of
+// the positions, normals, uvs, tangents and indices streams.
+struct MeshFileHeader
+{
+	char magic[4];            // "GMSH"
+	uint32_t version;
+	uint64_t sourceSize;      // size, modification time and hash of the
+	int64_t sourceTime;       // file the mesh was built from, used to
+	uint64_t sourceHash;      // detect stale caches
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;       // 2 or 4
+	uint32_t meshletCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t positionsOffset; // vec3 per vertex
+	uint64_t normalsOffset;   // vec3 per vertex
+	uint64_t uvsOffset;       // vec2 per vertex
+	uint64_t indicesOffset;
+	uint64_t meshletsOffset;  // Meshlet array, covering the first level of detail in order
+	uint32_t lodCount;
+	uint32_t encoding;        // MeshEncoding
+	uint64_t lodsOffset;      // MeshLod array, finest first
+	uint64_t tangentsOffset;  // vec4 per vertex, 0 when the mesh has no tangents
+	uint64_t encodedVerticesOffset; // MeshEncoded only: QuantizedVertex stream,
+	uint64_t encodedVerticesSize;
+	uint64_t encodedTangentsOffset; // QuantizedTangent stream (0 without tangents)
+	uint64_t encodedTangentsSize;
+	uint64_t encodedIndicesOffset;  // and indices, indexSize bytes wide once decoded
+	uint64_t encodedIndicesSize;
+};
+
+enum MeshEncoding : uint32_t
+{
+	MeshRaw = 0,
+	MeshEncoded = 1
+};
+
+const uint32_t kMeshFileVersion = 6;
+
+// Loads an OBJ or PLY (by extension) and makes it ready to draw: tangents,
+// optimized triangle and vertex order, meshlets and levels of detail
+bool buildMesh(const char* path, Mesh& mesh, const ObjLoadOptions& options = ObjLoadOptions());
+
+// With encode, the file holds the quantized vertices and the indices
+// compressed: several times smaller, but only the quantized vertex layout
+// can be uploaded without decoding it first (see decodeMesh)
+bool writeMeshFile(const char* path, const MeshView& view, const SourceInfo& source, bool encode = false);
+
+// Maps a mesh file and points view at its streams
+bool mapMeshFile(const char* path, MappedFile& file, MeshView& view, MeshFileHeader& header);
+
+// Same for a mesh file already in memory, e.g. in an asset pack. data must be
+// 16-byte aligned and outlive the view.
+bool viewMeshFile(const char* data, size_t size, MeshView& view, MeshFileHeader& header);
+
+// Mesh loaded through its binary cache. The view points into the mapped
+// cache file when it was up to date, into mesh when it had to be rebuilt.
+struct MeshAsset
+{
+	MappedFile file;
+	Mesh mesh;
+	MeshView view;
+};
+
+// Loads an OBJ or PLY (by extension) through "<path>.mesh": the first load writes the cache next to
+// the source and later ones only map it. A cache whose source changed (size,
+// time and hash) is rebuilt transparently through buildMesh.
+bool loadMesh(const char* path, MeshAsset& asset, const ObjLoadOptions& options = ObjLoadOptions());
+
+// Decodes an encoded view into asset.mesh and points the view there; nothing
+// to do for other views
+bool decodeMeshAsset(MeshAsset& asset);
@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <cstring>
+
+#include "meshcodec.h"
+#include "quantize.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHCODEC_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Every stream starts with its kind, the codec version, and the element
+// stride: vertex size, or 4 for indices whatever their decoded size
+const uint8_t kVertexStream = 0xA0;
+const uint8_t kIndexStream = 0xA1;
+const uint8_t kCodecVersion = 0;
+const size_t kStreamHeaderSize = 4;
+
+const size_t kGroupSize = 16;
+
+// Payload bytes of a group by mode: all zeros, 2, 4 or 8 bits per byte
+const size_t kGroupBytes[4] = { 0, 4, 8, 16 };
+
+static_assert(kCodecBlockSize % kGroupSize == 0, "blocks are made of whole groups");
+
+inline uint8_t zigzag8(uint8_t delta)
+{
+	return (uint8_t)((delta << 1) ^ (uint8_t)((int8_t)delta >> 7));
+}
+
+inline uint8_t unzigzag8(uint8_t value)
+{
+	return (uint8_t)((value >> 1) ^ (uint8_t)-(value & 1));
+}
+
+inline uint32_t zigzag32(uint32_t delta)
+{
+	return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+inline uint32_t unzigzag32(uint32_t value)
+{
+	return (value >> 1) ^ (uint32_t)-(int32_t)(value & 1);
+}
+
+inline uint32_t readIndex(const void* indices, unsigned indexSize, size_t i)
+{
+	return indexSize == 2 ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+}
+
+// One plane of a block: 2-bit modes for every group, then their payloads.
+// Value i of a 2-bit group sits in byte i % 4 at bit 2 * (i / 4), of a 4-bit
+// group in byte i % 8 at bit 4 * (i / 8), so that both unpack with a few
+// shifts and masks on 64-bit words.
+void encodePlane(const uint8_t* values, size_t groupCount, std::vector<uint8_t>& out)
+{
+	const size_t modesOffset = out.size();
+	out.resize(out.size() + (groupCount + 3) / 4, 0);
+	for (size_t group = 0; group < groupCount; group++)
+	{
+		const uint8_t* v = values + group * kGroupSize;
+		uint8_t bits = 0;
+		for (size_t i = 0; i < kGroupSize; i++)
+			bits |= v[i];
+		const unsigned mode = bits == 0 ? 0 : bits < 4 ? 1 : bits < 16 ? 2 : 3;
+		out[modesOffset + group / 4] |= (uint8_t)(mode << (group % 4 * 2));
+
+		uint8_t payload[kGroupSize] = {};
+		if (mode == 1)
+			for (size_t i = 0; i < kGroupSize; i++)
+				payload[i % 4] |= (uint8_t)(v[i] << (i / 4 * 2));
+		else if (mode == 2)
+			for (size_t i = 0; i < kGroupSize; i++)
+				payload[i % 8] |= (uint8_t)(v[i] << (i / 8 * 4));
+		else if (mode == 3)
+			memcpy(payload, v, kGroupSize);
+		out.insert(out.end(), payload, payload + kGroupBytes[mode]);
+	}
+}
+
+// Inverse of encodePlane, into groupCount * 16 values; false when data runs out
+bool decodePlane(const uint8_t*& data, const uint8_t* end, uint8_t* values, size_t groupCount)
+{
+	const size_t modeBytes = (groupCount + 3) / 4;
+	if ((size_t)(end - data) < modeBytes)
+		return false;
+	const uint8_t* modes = data;
+	data += modeBytes;
+
+	for (size_t group = 0; group < groupCount; group++)
+	{
+		const unsigned mode = modes[group / 4] >> (group % 4 * 2) & 3;
+		if ((size_t)(end - data) < kGroupBytes[mode])
+			return false;
+
+		uint64_t low = 0, high = 0;
+		if (mode == 1)
+		{
+			uint32_t x;
+			memcpy(&x, data, 4);
+			const uint32_t mask = 0x03030303u;
+			low = (x & mask) | (uint64_t)(x >> 2 & mask) << 32;
+			high = (x >> 4 & mask) | (uint64_t)(x >> 6 & mask) << 32;
+		}
+		else if (mode == 2)
+		{
+			uint64_t x;
+			memcpy(&x, data, 8);
+			const uint64_t mask = 0x0F0F0F0F0F0F0F0Full;
+			low = x & mask;
+			high = x >> 4 & mask;
+		}
+		else if (mode == 3)
+		{
+			memcpy(&low, data, 8);
+			memcpy(&high, data + 8, 8);
+		}
+		memcpy(values + group * kGroupSize, &low, 8);
+		memcpy(values + group * kGroupSize + 8, &high, 8);
+		data += kGroupBytes[mode];
+	}
+	return true;
+}
+
+void writeStreamHeader(std::vector<uint8_t>& out, uint8_t kind, size_t stride)
+{
+	const uint8_t header[kStreamHeaderSize] = { kind, kCodecVersion, (uint8_t)stride, 0 };
+	out.insert(out.end(), header, header + kStreamHeaderSize);
+}
+
+#ifdef MESHCODEC_SSE
+
+// Undoes zigzag then the bytewise delta of 16 values following carry
+inline __m128i unzigzagPrefix8(__m128i z, __m128i carry)
+{
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i half = _mm_and_si128(_mm_srli_epi16(z, 1), _mm_set1_epi8(0x7F));
+	__m128i x = _mm_xor_si128(half, _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(z, one)));
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+	return _mm_add_epi8(x, carry);
+}
+
+inline __m128i broadcastLast8(__m128i x)
+{
+	const __m128i words = _mm_shufflehi_epi16(_mm_unpackhi_epi8(x, x), _MM_SHUFFLE(3, 3, 3, 3));
+	return _mm_shuffle_epi32(words, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Offsets of the 4 groups a mode byte describes, and their total size
+struct GroupOffsets
+{
+	uint8_t offsets[256][4];
+	uint8_t sizes[256];
+
+	GroupOffsets()
+	{
+		for (unsigned modes = 0; modes < 256; modes++)
+		{
+			unsigned offset = 0;
+			for (unsigned j = 0; j < 4; j++)
+			{
+				offsets[modes][j] = (uint8_t)offset;
+				offset += (unsigned)kGroupBytes[modes >> (2 * j) & 3];
+			}
+			sizes[modes] = (uint8_t)offset;
+		}
+	}
+};
+
+// Masks keeping the 2-bit, 4-bit or raw unpacking of a group, by mode
+alignas(16) const int32_t kModeMasks[4][3][4] = {
+	{ { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } },
+	{ { -1, -1, -1, -1 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } },
+	{ { 0, 0, 0, 0 }, { -1, -1, -1, -1 }, { 0, 0, 0, 0 } },
+	{ { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { -1, -1, -1, -1 } },
+};
+
+// decodePlane reading 16 bytes per group whatever its mode, so that
+// selecting the unpacked values takes masks instead of branches on modes,
+// which vary too much to predict. Groups of a mode byte are located from it
+// at once, rather than each waiting for the size of the previous one. data
+// must have the bytes of every group plus 16. Vertex planes are undone
+// from their last byte on the way (Prefix), while still in registers.
+template <bool Prefix>
+inline void decodePlaneSSE(const uint8_t*& data, uint8_t* values, size_t groupCount, uint8_t& last)
+{
+	__m128i carry = _mm_set1_epi8((char)last);
+	static const GroupOffsets table;
+	const uint8_t* modes = data;
+	data += (groupCount + 3) / 4;
+	const __m128i crumbMask = _mm_set1_epi8(3), nibbleMask = _mm_set1_epi8(15);
+	for (size_t first = 0; first < groupCount; first += 4)
+	{
+		const unsigned modeByte = modes[first / 4];
+		const size_t lanes = std::min<size_t>(4, groupCount - first);
+		for (size_t j = 0; j < lanes; j++)
+		{
+			const unsigned mode = modeByte >> (2 * j) & 3;
+			const __m128i raw = _mm_loadu_si128((const __m128i*)(data + table.offsets[modeByte][j]));
+
+			// Nibbles: low ones of the 8 bytes, then high ones. Crumbs split
+			// the nibbles of the first 4 bytes the same way.
+			const __m128i nibbles = _mm_unpacklo_epi64(_mm_and_si128(raw, nibbleMask), _mm_and_si128(_mm_srli_epi16(raw, 4), nibbleMask));
+			const __m128i low = _mm_shuffle_epi32(_mm_and_si128(nibbles, crumbMask), _MM_SHUFFLE(3, 1, 2, 0));
+			const __m128i high = _mm_shuffle_epi32(_mm_and_si128(_mm_srli_epi16(nibbles, 2), crumbMask), _MM_SHUFFLE(3, 1, 2, 0));
+			const __m128i crumbs = _mm_unpacklo_epi32(low, high);
+
+			const __m128i* masks = (const __m128i*)kModeMasks[mode];
+			const __m128i value = _mm_or_si128(_mm_or_si128(
+				_mm_and_si128(crumbs, _mm_load_si128(masks)),
+				_mm_and_si128(nibbles, _mm_load_si128(masks + 1))),
+				_mm_and_si128(raw, _mm_load_si128(masks + 2)));
+			if (Prefix)
+			{
+				const __m128i x = unzigzagPrefix8(value, carry);
+				_mm_storeu_si128((__m128i*)(values + (first + j) * kGroupSize), x);
+				carry = broadcastLast8(x);
+			}
+			else
+				_mm_storeu_si128((__m128i*)(values + (first + j) * kGroupSize), value);
+		}
+		data += table.sizes[modeByte];
+	}
+	last = (uint8_t)_mm_cvtsi128_si32(carry);
+}
+
+// Four planes of 16 values into 16 elements of 4 bytes, 4 per register
+inline void transpose4x16(__m128i p0, __m128i p1, __m128i p2, __m128i p3, __m128i r[4])
+{
+	const __m128i a = _mm_unpacklo_epi8(p0, p1), b = _mm_unpacklo_epi8(p2, p3);
+	const __m128i c = _mm_unpackhi_epi8(p0, p1), d = _mm_unpackhi_epi8(p2, p3);
+	r[0] = _mm_unpacklo_epi16(a, b);
+	r[1] = _mm_unpackhi_epi16(a, b);
+	r[2] = _mm_unpacklo_epi16(c, d);
+	r[3] = _mm_unpackhi_epi16(c, d);
+}
+
+#endif
+
+}
+
+void encodeVertexBuffer(const void* vertices, size_t count, size_t stride, std::vector<uint8_t>& out)
+{
+	writeStreamHeader(out, kVertexStream, stride);
+	const uint8_t* bytes = (const uint8_t*)vertices;
+	uint8_t last[kMaxEncodedStride] = {};
+	uint8_t values[kCodecBlockSize];
+
+	for (size_t first = 0; first < count; first += kCodecBlockSize)
+	{
+		const size_t n = std::min(kCodecBlockSize, count - first);
+		const size_t groupCount = (n + kGroupSize - 1) / kGroupSize;
+		for (size_t k = 0; k < stride; k++)
+		{
+			memset(values, 0, sizeof(values));
+			uint8_t previous = last[k];
+			for (size_t i = 0; i < n; i++)
+			{
+				const uint8_t value = bytes[(first + i) * stride + k];
+				values[i] = zigzag8((uint8_t)(value - previous));
+				previous = value;
+			}
+			last[k] = previous;
+			encodePlane(values, groupCount, out);
+		}
+	}
+}
+
+void encodeIndexBuffer(const void* indices, size_t count, unsigned indexSize, std::vector<uint8_t>& out)
+{
+	writeStreamHeader(out, kIndexStream, 4);
+	uint32_t last = 0;
+	uint32_t deltas[kCodecBlockSize];
+	uint8_t values[kCodecBlockSize];
+
+	for (size_t first = 0; first < count; first += kCodecBlockSize)
+	{
+		const size_t n = std::min(kCodecBlockSize, count - first);
+		const size_t groupCount = (n + kGroupSize - 1) / kGroupSize;
+		for (size_t i = 0; i < n; i++)
+		{
+			const uint32_t index = readIndex(indices, indexSize, first + i);
+			deltas[i] = zigzag32(index - last);
+			last = index;
+		}
+		for (size_t k = 0; k < 4; k++)
+		{
+			memset(values, 0, sizeof(values));
+			for (size_t i = 0; i < n; i++)
+				values[i] = (uint8_t)(deltas[i] >> (8 * k));
+			encodePlane(values, groupCount, out);
+		}
+	}
+}
+
+bool StreamDecoder::begin(const uint8_t* source, size_t size, size_t elementCount, uint8_t kind, size_t elementStride, size_t elementPlanes)
+{
+	data = end = nullptr;
+	if (size < kStreamHeaderSize || source[0] != kind || source[1] != kCodecVersion || source[2] != elementPlanes)
+		return false;
+	data = source + kStreamHeaderSize;
+	end = source + size;
+	count = elementCount;
+	stride = elementStride;
+	planeCount = elementPlanes;
+	emitted = 0;
+	memset(lastVertex, 0, sizeof(lastVertex));
+	lastIndex = 0;
+	this->planes.resize(planeCount * kCodecBlockSize);
+	block.resize(kCodecBlockSize * stride);
+	blockCount = blockCopied = 0;
+	return true;
+}
+
+bool StreamDecoder::beginVertices(const uint8_t* source, size_t size, size_t elementCount, size_t elementStride)
+{
+	indices = false;
+	if (elementStride == 0 || elementStride % 4 != 0 || elementStride > kMaxEncodedStride)
+		return false;
+	return begin(source, size, elementCount, kVertexStream, elementStride, elementStride);
+}
+
+bool StreamDecoder::beginIndices(const uint8_t* source, size_t size, size_t elementCount, unsigned indexSize)
+{
+	indices = true;
+	if (indexSize != 2 && indexSize != 4)
+		return false;
+	return begin(source, size, elementCount, kIndexStream, indexSize, 4);
+}
+
+bool StreamDecoder::decodeBlock(uint8_t* out)
+{
+	const size_t n = std::min(kCodecBlockSize, count - emitted);
+	const size_t groupCount = (n + kGroupSize - 1) / kGroupSize;
+	bool undone[kMaxEncodedStride] = {};
+	for (size_t k = 0; k < planeCount; k++)
+	{
+		uint8_t* plane = planes.data() + k * kCodecBlockSize;
+#ifdef MESHCODEC_SSE
+		if ((size_t)(end - data) >= (groupCount + 3) / 4 + groupCount * kGroupSize + kGroupSize)
+		{
+			uint8_t unused = 0;
+			if (indices)
+				decodePlaneSSE<false>(data, plane, groupCount, unused);
+			else
+				decodePlaneSSE<true>(data, plane, groupCount, lastVertex[k]);
+			undone[k] = !indices;
+			continue;
+		}
+#endif
+		if (!decodePlane(data, end, plane, groupCount))
+			return false;
+	}
+
+	// Past the n elements planes hold zeros, so prefix sums run over whole
+	// groups without changing the last element
+	const size_t padded = groupCount * kGroupSize;
+
+	if (!indices)
+	{
+		// Planes decoded without SSE (all of them, or near the end of the
+		// stream) still hold deltas
+		for (size_t k = 0; k < planeCount; k++)
+		{
+			if (undone[k])
+				continue;
+			uint8_t* plane = planes.data() + k * kCodecBlockSize;
+			uint8_t value = lastVertex[k];
+			for (size_t i = 0; i < padded; i++)
+				plane[i] = value = (uint8_t)(value + unzigzag8(plane[i]));
+			lastVertex[k] = value;
+		}
+
+#ifdef MESHCODEC_SSE
+		// 16 bytes of 16 elements at a time: four planes make 4-byte columns,
+		// which a 4x4 transposition turns into whole 16-byte rows. The block
+		// buffer has room for whole groups, trailing ones are simply unused.
+		const size_t wide = stride / 16 * 16;
+		for (size_t i = 0; i < padded; i += kGroupSize)
+		{
+			for (size_t k = 0; k < wide; k += 16)
+			{
+				__m128i r[4][4];
+				for (int q = 0; q < 4; q++)
+				{
+					const uint8_t* plane = planes.data() + (k + 4 * q) * kCodecBlockSize + i;
+					transpose4x16(_mm_loadu_si128((const __m128i*)plane),
+						_mm_loadu_si128((const __m128i*)(plane + kCodecBlockSize)),
+						_mm_loadu_si128((const __m128i*)(plane + 2 * kCodecBlockSize)),
+						_mm_loadu_si128((const __m128i*)(plane + 3 * kCodecBlockSize)), r[q]);
+				}
+				for (int j = 0; j < 4; j++)
+				{
+					const __m128i a = _mm_unpacklo_epi32(r[0][j], r[1][j]), b = _mm_unpacklo_epi32(r[2][j], r[3][j]);
+					const __m128i c = _mm_unpackhi_epi32(r[0][j], r[1][j]), d = _mm_unpackhi_epi32(r[2][j], r[3][j]);
+					uint8_t* row = out + (i + 4 * j) * stride + k;
+					_mm_storeu_si128((__m128i*)row, _mm_unpacklo_epi64(a, b));
+					_mm_storeu_si128((__m128i*)(row + stride), _mm_unpackhi_epi64(a, b));
+					_mm_storeu_si128((__m128i*)(row + 2 * stride), _mm_unpacklo_epi64(c, d));
+					_mm_storeu_si128((__m128i*)(row + 3 * stride), _mm_unpackhi_epi64(c, d));
+				}
+			}
+			for (size_t k = wide; k < stride; k += 4)
+			{
+				const uint8_t* plane = planes.data() + k * kCodecBlockSize + i;
+				__m128i r[4];
+				transpose4x16(_mm_loadu_si128((const __m128i*)plane),
+					_mm_loadu_si128((const __m128i*)(plane + kCodecBlockSize)),
+					_mm_loadu_si128((const __m128i*)(plane + 2 * kCodecBlockSize)),
+					_mm_loadu_si128((const __m128i*)(plane + 3 * kCodecBlockSize)), r);
+				uint32_t lanes[16];
+				for (int j = 0; j < 4; j++)
+					_mm_storeu_si128((__m128i*)(lanes + 4 * j), r[j]);
+				for (size_t j = 0; j < kGroupSize; j++)
+					memcpy(out + (i + j) * stride + k, lanes + j, 4);
+			}
+		}
+#else
+		for (size_t i = 0; i < n; i++)
+			for (size_t k = 0; k < planeCount; k++)
+				out[i * stride + k] = planes[k * kCodecBlockSize + i];
+#endif
+	}
+	else
+	{
+		const uint8_t* plane = planes.data();
+#ifdef MESHCODEC_SSE
+		__m128i carry = _mm_set1_epi32((int)lastIndex);
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128i bias32 = _mm_set1_epi32(0x8000), bias16 = _mm_set1_epi16(-0x8000);
+		for (size_t i = 0; i < padded; i += kGroupSize)
+		{
+			__m128i r[4];
+			transpose4x16(_mm_loadu_si128((const __m128i*)(plane + i)),
+				_mm_loadu_si128((const __m128i*)(plane + kCodecBlockSize + i)),
+				_mm_loadu_si128((const __m128i*)(plane + 2 * kCodecBlockSize + i)),
+				_mm_loadu_si128((const __m128i*)(plane + 3 * kCodecBlockSize + i)), r);
+			for (int j = 0; j < 4; j++)
+			{
+				const __m128i z = r[j];
+				__m128i x = _mm_xor_si128(_mm_srli_epi32(z, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(z, one)));
+				x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+				x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+				r[j] = x = _mm_add_epi32(x, carry);
+				carry = _mm_shuffle_epi32(x, 0xFF);
+			}
+			// Blocks are padded, so whole groups fit in the block buffer
+			if (stride == 4)
+			{
+				for (int j = 0; j < 4; j++)
+					_mm_storeu_si128((__m128i*)(out + (i + 4 * j) * 4), r[j]);
+			}
+			else
+			{
+				// Signed saturation keeps values in range once biased
+				for (int j = 0; j < 4; j += 2)
+				{
+					const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(r[j], bias32), _mm_sub_epi32(r[j + 1], bias32));
+					_mm_storeu_si128((__m128i*)(out + (i + 4 * j) * 2), _mm_sub_epi16(packed, bias16));
+				}
+			}
+		}
+		// Padding deltas are zeros: the last lane carries the last index
+		lastIndex = (uint32_t)_mm_cvtsi128_si32(carry);
+#else
+		uint32_t index = lastIndex;
+		for (size_t i = 0; i < n; i++)
+		{
+			const uint32_t z = plane[i] | plane[kCodecBlockSize + i] << 8 | plane[2 * kCodecBlockSize + i] << 16 | (uint32_t)plane[3 * kCodecBlockSize + i] << 24;
+			index += unzigzag32(z);
+			if (stride == 4)
+				memcpy(out + i * 4, &index, 4);
+			else
+			{
+				const uint16_t narrow = (uint16_t)index;
+				memcpy(out + i * 2, &narrow, 2);
+			}
+		}
+		lastIndex = index;
+#endif
+	}
+
+	blockCount = n;
+	blockCopied = 0;
+	return true;
+}
+
+bool StreamDecoder::decode(void* destination, size_t maxCount)
+{
+	uint8_t* out = (uint8_t*)destination;
+	size_t left = std::min(maxCount, remaining());
+	while (left > 0)
+	{
+		// Whole blocks are decoded in place, they have no padding to spill
+		if (blockCopied == blockCount && left >= kCodecBlockSize)
+		{
+			if (!decodeBlock(out))
+				return false;
+			blockCopied = blockCount;
+			out += kCodecBlockSize * stride;
+			emitted += kCodecBlockSize;
+			left -= kCodecBlockSize;
+			continue;
+		}
+		if (blockCopied == blockCount && !decodeBlock(block.data()))
+			return false;
+		const size_t n = std::min(left, blockCount - blockCopied);
+		memcpy(out, block.data() + blockCopied * stride, n * stride);
+		out += n * stride;
+		blockCopied += n;
+		emitted += n;
+		left -= n;
+	}
+	return true;
+}
+
+bool decodeVertexBuffer(void* destination, size_t count, size_t stride, const uint8_t* data, size_t size)
+{
+	StreamDecoder decoder;
+	return decoder.beginVertices(data, size, count, stride) && decoder.decode(destination, count) && decoder.finished();
+}
+
+bool decodeIndexBuffer(void* destination, size_t count, unsigned indexSize, const uint8_t* data, size_t size)
+{
+	StreamDecoder decoder;
+	return decoder.beginIndices(data, size, count, indexSize) && decoder.decode(destination, count) && decoder.finished();
+}
+
+bool decodeMesh(const MeshView& view, Mesh& mesh)
+{
+	std::vector<QuantizedVertex> vertices(view.vertexCount);
+	if (!decodeVertexBuffer(vertices.data(), vertices.size(), sizeof(QuantizedVertex), view.encodedVertices, view.encodedVerticesSize))
+		return false;
+	mesh.positions.resize(view.vertexCount);
+	mesh.normals.resize(view.vertexCount);
+	mesh.uvs.resize(view.vertexCount);
+	for (size_t i = 0; i < view.vertexCount; i++)
+		dequantizeVertex(vertices[i], view.bounds, mesh.positions[i], mesh.normals[i], mesh.uvs[i]);
+
+	mesh.tangents.clear();
+	if (view.encodedTangents)
+	{
+		std::vector<QuantizedTangent> tangents(view.vertexCount);
+		if (!decodeVertexBuffer(tangents.data(), tangents.size(), sizeof(QuantizedTangent), view.encodedTangents, view.encodedTangentsSize))
+			return false;
+		mesh.tangents.resize(view.vertexCount);
+		for (size_t i = 0; i < view.vertexCount; i++)
+			mesh.tangents[i] = dequantizeTangent(tangents[i]);
+	}
+
+	mesh.indices.resize(view.indexCount);
+	if (!decodeIndexBuffer(mesh.indices.data(), mesh.indices.size(), 4, view.encodedIndices, view.encodedIndicesSize))
+		return false;
+	mesh.meshlets.assign(view.meshlets, view.meshlets + view.meshletCount);
+	mesh.lods.assign(view.lods, view.lods + view.lodCount);
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Lossless codec for quantized vertex and index buffers, in the spirit of
+// meshoptimizer's. Streams are cut in blocks of kCodecBlockSize elements;
+// every byte of an element forms a plane of deltas (bytewise from the
+// previous vertex, or between consecutive 32-bit indices), zigzag-encoded so
+// that small steps either way give small bytes, and stored by groups of 16
+// in 0, 2, 4 or 8 bits each. Optimized meshes store nearby vertices next to
+// each other, so most groups take 2 or 4 bits; LZ4 on top (asset packs)
+// squeezes a bit more.
+
+const size_t kCodecBlockSize = 256;
+const size_t kMaxEncodedStride = 64;
+
+// Appends the stream encoding count vertices of stride bytes, a multiple of
+// 4 up to kMaxEncodedStride
+void encodeVertexBuffer(const void* vertices, size_t count, size_t stride, std::vector<uint8_t>& out);
+
+// Appends the stream encoding count indices of indexSize (2 or 4) bytes
+void encodeIndexBuffer(const void* indices, size_t count, unsigned indexSize, std::vector<uint8_t>& out);
+
+// Decodes a stream piece by piece, e.g. a few hundred kilobytes per frame,
+// straight into memory it only ever writes, in order: mapped GL buffers are
+// fine. SSE2 does the delta, zigzag and transposition steps when available.
+class StreamDecoder
+{
+public:
+	// false when data does not start an encoded stream of that kind
+	bool beginVertices(const uint8_t* data, size_t size, size_t count, size_t stride);
+	bool beginIndices(const uint8_t* data, size_t size, size_t count, unsigned indexSize);
+
+	// Writes the next min(maxCount, remaining()) elements to destination,
+	// tightly packed; false on corrupt input
+	bool decode(void* destination, size_t maxCount);
+
+	size_t elementSize() const { return stride; }
+	size_t remaining() const { return count - emitted; }
+
+	// Every element was decoded and the stream had nothing more
+	bool finished() const { return emitted == count && data == end; }
+
+private:
+	bool begin(const uint8_t* data, size_t size, size_t count, uint8_t kind, size_t stride, size_t elementPlanes);
+	// Next block into out, which has room for kCodecBlockSize elements
+	bool decodeBlock(uint8_t* out);
+
+	const uint8_t* data = nullptr;
+	const uint8_t* end = nullptr;
+	bool indices = false;
+	size_t count = 0;
+	size_t stride = 0;
+	size_t planeCount = 0;
+	size_t emitted = 0;
+
+	// Last element of the previous block, which deltas continue from
+	uint8_t lastVertex[kMaxEncodedStride] = {};
+	uint32_t lastIndex = 0;
+
+	// Current block: its planes, then its elements
+	std::vector<uint8_t> planes;
+	std::vector<uint8_t> block;
+	size_t blockCount = 0;
+	size_t blockCopied = 0;
+};
+
+bool decodeVertexBuffer(void* destination, size_t count, size_t stride, const uint8_t* data, size_t size);
+bool decodeIndexBuffer(void* destination, size_t count, unsigned indexSize, const uint8_t* data, size_t size);
+
+// Decodes the streams of an encoded view (a compressed mesh file) into mesh:
+// dequantized positions, normals, uvs and tangents, indices, meshlets and
+// levels of detail
+bool decodeMesh(const MeshView& view, Mesh& mesh);
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "meshlet.h"
+#include "meshopt.h"
+
+namespace {
+
+// Unused triangles looked at to pick the next seed when a meshlet runs out of neighbours
+const size_t kSeedWindow = 1024;
+
+// Growing meshlets loses the vertex cache order: redo it within each one,
+// on indices local to the meshlet
+void optimizeMeshletOrder(const Meshlet& meshlet, std::vector<uint32_t>& indices)
+{
+	uint32_t* begin = &indices[meshlet.indexOffset];
+	const size_t indexCount = meshlet.triangleCount * 3;
+
+	uint32_t globals[kMeshletMaxVertices];
+	size_t vertexCount = 0;
+	std::vector<uint32_t> local(indexCount);
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		size_t slot = 0;
+		while (slot < vertexCount && globals[slot] != begin[i])
+			slot++;
+		if (slot == vertexCount)
+			globals[vertexCount++] = begin[i];
+		local[i] = (uint32_t)slot;
+	}
+
+	optimizeVertexCache(local, vertexCount);
+	for (size_t i = 0; i < indexCount; i++)
+		begin[i] = globals[local[i]];
+}
+
+// Bounds of the meshlet vertices and the narrowest cone around the mean
+// normal of its triangles
+void computeCullData(Meshlet& meshlet, const Mesh& mesh)
+{
+	const uint32_t* indices = &mesh.indices[meshlet.indexOffset];
+	const size_t indexCount = meshlet.triangleCount * 3;
+
+	glm::vec3 lo = mesh.positions[indices[0]], hi = lo;
+	for (size_t i = 1; i < indexCount; i++)
+	{
+		lo = glm::min(lo, mesh.positions[indices[i]]);
+		hi = glm::max(hi, mesh.positions[indices[i]]);
+	}
+	meshlet.center = (lo + hi) * 0.5f;
+	float radius = 0.f;
+	for (size_t i = 0; i < indexCount; i++)
+		radius = std::max(radius, glm::length(mesh.positions[indices[i]] - meshlet.center));
+	meshlet.radius = radius;
+
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangleCount);
+	glm::vec3 axis(0.f);
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		const glm::vec3& a = mesh.positions[indices[i]];
+		const glm::vec3 n = glm::cross(mesh.positions[indices[i + 1]] - a, mesh.positions[indices[i + 2]] - a);
+		const float length = glm::length(n);
+		if (length > 0.f)
+		{
+			normals.push_back(n / length);
+			axis += normals.back();
+		}
+	}
+
+	meshlet.coneAxis = glm::vec3(0.f);
+	meshlet.coneCutoff = 1.f;
+	const float axisLength = glm::length(axis);
+	if (normals.empty() || axisLength == 0.f)
+		return;
+	axis /= axisLength;
+
+	float minDot = 1.f;
+	for (const glm::vec3& n : normals)
+		minDot = std::min(minDot, glm::dot(n, axis));
+
+	// Past roughly 85 degrees the test would hardly ever succeed
+	meshlet.coneAxis = axis;
+	if (minDot > 0.1f)
+		meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+}
+
+}
+
+void buildMeshlets(Mesh& mesh)
+{
+	const size_t triangleCount = mesh.triangleCount();
+	const size_t vertexCount = mesh.vertexCount();
+	mesh.meshlets.clear();
+	if (triangleCount == 0)
+		return;
+
+	// Triangles of each vertex
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v : mesh.indices)
+		offsets[v + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<uint32_t> adjacency(mesh.indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+			adjacency[fill[mesh.indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<glm::vec3> triangleNormals(triangleCount), triangleCenters(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& a = mesh.positions[mesh.indices[t * 3]];
+		const glm::vec3& b = mesh.positions[mesh.indices[t * 3 + 1]];
+		const glm::vec3& c = mesh.positions[mesh.indices[t * 3 + 2]];
+		const glm::vec3 n = glm::cross(b - a, c - a);
+		const float length = glm::length(n);
+		triangleNormals[t] = length > 0.f ? n / length : glm::vec3(0.f);
+		triangleCenters[t] = (a + b + c) / 3.f;
+	}
+	auto distanceTo = [&](size_t t, const glm::vec3& p) { return glm::length(triangleCenters[t] - p); };
+
+	std::vector<bool> used(triangleCount, false);
+	// Meshlet the vertex was last added to, plus one
+	std::vector<uint32_t> owner(vertexCount, 0);
+
+	std::vector<uint32_t> output;
+	output.reserve(mesh.indices.size());
+
+	uint32_t meshletVertices[kMeshletMaxVertices];
+	size_t cursor = 0;
+	size_t emitted = 0;
+	while (emitted < triangleCount)
+	{
+		Meshlet meshlet = {};
+		meshlet.indexOffset = (uint32_t)output.size();
+		const uint32_t stamp = (uint32_t)mesh.meshlets.size() + 1;
+		size_t vertices = 0;
+		glm::vec3 normal(0.f);
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+
+		while (meshlet.triangleCount < kMeshletMaxTriangles && emitted < triangleCount)
+		{
+			// Best neighbour: fewest new vertices, then closest to the meshlet normal
+			long best = -1;
+			int bestNew = 4;
+			float bestDot = -2.f;
+			for (size_t i = 0; i < vertices && bestNew > 0; i++)
+			{
+				const uint32_t v = meshletVertices[i];
+				for (uint32_t j = offsets[v]; j < offsets[v + 1]; j++)
+				{
+					const uint32_t t = adjacency[j];
+					if (used[t])
+						continue;
+					int added = 0;
+					for (int k = 0; k < 3; k++)
+						added += owner[mesh.indices[t * 3 + k]] != stamp;
+					const float d = glm::dot(triangleNormals[t], normal);
+					if (added < bestNew || (added == bestNew && d > bestDot))
+					{
+						best = t;
+						bestNew = added;
+						bestDot = d;
+					}
+				}
+			}
+
+			// No neighbour left: continue with the closest of the next triangles
+			// in the current order, so that disconnected parts stay compact
+			if (best < 0)
+			{
+				while (used[cursor])
+					cursor++;
+				best = (long)cursor;
+				if (meshlet.triangleCount > 0)
+				{
+					const glm::vec3 center = (lo + hi) * 0.5f;
+					float bestDistance = distanceTo(best, center);
+					size_t scanned = 0;
+					for (size_t t = cursor + 1; t < triangleCount && scanned < kSeedWindow; t++)
+					{
+						if (used[t])
+							continue;
+						scanned++;
+						const float distance = distanceTo(t, center);
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							best = (long)t;
+						}
+					}
+				}
+				bestNew = 0;
+				for (int k = 0; k < 3; k++)
+					bestNew += owner[mesh.indices[best * 3 + k]] != stamp;
+			}
+			if (vertices + bestNew > kMeshletMaxVertices)
+				break;
+
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t v = mesh.indices[best * 3 + k];
+				if (owner[v] != stamp)
+				{
+					owner[v] = stamp;
+					meshletVertices[vertices++] = v;
+				}
+				output.push_back(v);
+			}
+			used[best] = true;
+			lo = glm::min(lo, triangleCenters[best]);
+			hi = glm::max(hi, triangleCenters[best]);
+			normal += triangleNormals[best];
+			meshlet.triangleCount++;
+			emitted++;
+		}
+		mesh.meshlets.push_back(meshlet);
+	}
+
+	mesh.indices.swap(output);
+	for (Meshlet& meshlet : mesh.meshlets)
+	{
+		optimizeMeshletOrder(meshlet, mesh.indices);
+		computeCullData(meshlet, mesh);
+	}
+}
+
+void cullMeshlets(const Meshlet* meshlets, size_t count, const glm::mat4& modelViewProjection, const glm::vec3* eye,
+	std::vector<DrawRange>& ranges, MeshletCullStats& stats)
+{
+	// Frustum planes in model space (Gribb & Hartmann), normalized so that
+	// distances compare with sphere radii
+	const glm::mat4& m = modelViewProjection;
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	glm::vec4 planes[6] = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	ranges.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		stats.triangles += meshlet.triangleCount;
+
+		bool inside = true;
+		for (const glm::vec4& plane : planes)
+			inside = inside && glm::dot(glm::vec3(plane), meshlet.center) + plane.w >= -meshlet.radius;
+		if (!inside)
+		{
+			stats.frustumCulled += meshlet.triangleCount;
+			continue;
+		}
+
+		if (eye && meshlet.coneCutoff < 1.f)
+		{
+			const glm::vec3 toCenter = meshlet.center - *eye;
+			if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+			{
+				stats.backfaceCulled += meshlet.triangleCount;
+				continue;
+			}
+		}
+
+		const uint32_t indexCount = meshlet.triangleCount * 3;
+		if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexCount == meshlet.indexOffset)
+			ranges.back().indexCount += indexCount;
+		else
+			ranges.push_back({ meshlet.indexOffset, indexCount });
+	}
+	stats.draws += ranges.size();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Groups the triangles of mesh in meshlets, growing each one through shared
+// vertices from the first triangle left in the current order, and reorders
+// mesh.indices so that every meshlet is a contiguous range
+void buildMeshlets(Mesh& mesh);
+
+// Range of indices to draw
+struct DrawRange
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+// Triangles considered and culled, accumulated over calls
+struct MeshletCullStats
+{
+	uint64_t triangles = 0;
+	uint64_t frustumCulled = 0;
+	uint64_t backfaceCulled = 0;
+	uint64_t draws = 0;
+};
+
+// Fills ranges with the meshlets inside the frustum of modelViewProjection
+// and, when eye (in model space) is given, not facing away from it. Adjacent
+// visible meshlets are merged in a single range.
+void cullMeshlets(const Meshlet* meshlets, size_t count, const glm::mat4& modelViewProjection, const glm::vec3* eye,
+	std::vector<DrawRange>& ranges, MeshletCullStats& stats);
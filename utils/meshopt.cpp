@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+#include "meshopt.h"
+#include "meshlet.h"
+#include "Timer.h"
+
+namespace {
+
+const int kCacheSize = 32;
+const unsigned kMaxValence = 32;
+
+// Score tables from Forsyth's article: the three most recent vertices get a
+// fixed score so that strips are not favoured over fans, older ones decay,
+// and vertices with few triangles left get a boost to finish them off.
+struct ScoreTables
+{
+	float cache[kCacheSize];
+	float valence[kMaxValence];
+
+	ScoreTables()
+	{
+		for (int i = 0; i < kCacheSize; i++)
+			cache[i] = i < 3 ? 0.75f : std::pow(1.f - (i - 3) / float(kCacheSize - 3), 1.5f);
+		valence[0] = 0.f;
+		for (unsigned i = 1; i < kMaxValence; i++)
+			valence[i] = 2.f / std::sqrt((float)i);
+	}
+};
+
+float vertexScore(const ScoreTables& tables, int cachePosition, unsigned remaining)
+{
+	if (remaining == 0)
+		return -1.f;
+	const float cache = cachePosition >= 0 ? tables.cache[cachePosition] : 0.f;
+	return cache + (remaining < kMaxValence ? tables.valence[remaining] : 2.f / std::sqrt((float)remaining));
+}
+
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || vertexCount == 0)
+		return stats;
+
+	// FIFO through timestamps: a vertex is cached when fewer than cacheSize
+	// misses happened since it was loaded
+	std::vector<size_t> loaded(vertexCount, 0);
+	size_t misses = 0;
+	for (uint32_t v : indices)
+	{
+		if (loaded[v] == 0 || misses - loaded[v] >= cacheSize)
+			loaded[v] = ++misses;
+	}
+
+	stats.acmr = (float)misses / (indices.size() / 3);
+	stats.atvr = (float)misses / vertexCount;
+	return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	static const ScoreTables tables;
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles of each vertex, the first remaining[v] of them not emitted yet
+	std::vector<unsigned> remaining(vertexCount, 0);
+	for (uint32_t v : indices)
+		remaining[v]++;
+	std::vector<size_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		score[v] = vertexScore(tables, -1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint32_t cache[kCacheSize + 3];
+	int cacheCount = 0;
+	size_t cursor = 0;
+	long best = (long)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// Nothing useful in the cache: continue with the next triangle in input order
+		if (best < 0)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = (long)cursor;
+		}
+
+		const uint32_t* triangle = &indices[best * 3];
+		output.insert(output.end(), triangle, triangle + 3);
+		emitted[best] = true;
+
+		// Remove the triangle from its vertices' live lists
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t v = triangle[k];
+			uint32_t* list = &adjacency[offsets[v]];
+			for (unsigned i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == (uint32_t)best)
+				{
+					std::swap(list[i], list[remaining[v] - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// New cache: the triangle's vertices first, then the previous content
+		uint32_t next[kCacheSize + 3];
+		int nextCount = 0;
+		for (int k = 0; k < 3; k++)
+			next[nextCount++] = triangle[k];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			const uint32_t v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				next[nextCount++] = v;
+		}
+
+		// Rescore everything that was or is in the cache; the entries pushed
+		// out lose their cache score
+		for (int i = 0; i < nextCount; i++)
+		{
+			const uint32_t v = next[i];
+			cachePosition[v] = i < kCacheSize ? i : -1;
+			score[v] = vertexScore(tables, cachePosition[v], remaining[v]);
+		}
+
+		best = -1;
+		float bestScore = 0.f;
+		for (int i = 0; i < nextCount; i++)
+		{
+			const uint32_t v = next[i];
+			const uint32_t* list = &adjacency[offsets[v]];
+			for (unsigned j = 0; j < remaining[v]; j++)
+			{
+				const uint32_t t = list[j];
+				const float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				triangleScore[t] = s;
+				if (s > bestScore)
+				{
+					bestScore = s;
+					best = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(nextCount, kCacheSize);
+		std::copy(next, next + cacheCount, cache);
+	}
+
+	indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, float threshold)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	const unsigned cacheSize = 16;
+	std::vector<size_t> loaded(positions.size(), 0);
+	size_t misses = 0;
+	auto simulate = [&](size_t t)
+	{
+		unsigned count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t v = indices[t * 3 + k];
+			if (loaded[v] == 0 || misses - loaded[v] >= cacheSize)
+			{
+				loaded[v] = ++misses;
+				count++;
+			}
+		}
+		return count;
+	};
+	// Pretend the cache was flushed
+	auto flush = [&]() { misses += cacheSize; };
+
+	// Hard boundaries: triangles that miss all three vertices start a new cluster anyway
+	std::vector<size_t> hard;
+	for (size_t t = 0; t < triangleCount; t++)
+		if (simulate(t) == 3)
+			hard.push_back(t);
+	hard.push_back(triangleCount);
+
+	// Soft boundaries: split a hard cluster as soon as the part seen so far is
+	// about as cache efficient as the whole cluster
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); h++)
+	{
+		const size_t begin = hard[h], end = hard[h + 1];
+
+		flush();
+		size_t clusterMisses = 0;
+		for (size_t t = begin; t < end; t++)
+			clusterMisses += simulate(t);
+		const float limit = (float)clusterMisses / (end - begin) * threshold;
+
+		flush();
+		size_t start = begin, startMisses = 0;
+		clusters.push_back(begin);
+		for (size_t t = begin; t < end; t++)
+		{
+			startMisses += simulate(t);
+			if (t + 1 < end && (float)startMisses / (t + 1 - start) <= limit)
+			{
+				clusters.push_back(t + 1);
+				start = t + 1;
+				startMisses = 0;
+				flush();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Area-weighted centroid and normal of every cluster and of the whole mesh
+	struct Cluster { size_t begin, end; float sortKey; };
+	std::vector<Cluster> sorted(clusters.size() - 1);
+	std::vector<glm::vec3> centroids(sorted.size()), normals(sorted.size());
+	glm::vec3 meshCentroid(0.f);
+	float meshArea = 0.f;
+	for (size_t c = 0; c < sorted.size(); c++)
+	{
+		glm::vec3 centroid(0.f), normal(0.f);
+		float area = 0.f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& a = positions[indices[t * 3]];
+			const glm::vec3& b = positions[indices[t * 3 + 1]];
+			const glm::vec3& d = positions[indices[t * 3 + 2]];
+			const glm::vec3 n = glm::cross(b - a, d - a);
+			const float w = glm::length(n);
+			centroid += (a + b + d) * (w / 3.f);
+			normal += n;
+			area += w;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids[c] = area > 0.f ? centroid / area : positions[indices[clusters[c] * 3]];
+		normals[c] = normal;
+		sorted[c] = { clusters[c], clusters[c + 1], 0.f };
+	}
+	if (meshArea > 0.f)
+		meshCentroid /= meshArea;
+
+	for (size_t c = 0; c < sorted.size(); c++)
+	{
+		const float length = glm::length(normals[c]);
+		sorted[c].sortKey = length > 0.f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.f;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (const Cluster& cluster : sorted)
+		output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	indices.swap(output);
+}
+
+void optimizeVertexFetch(Mesh& mesh)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.vertexCount(), unused);
+	uint32_t next = 0;
+	for (uint32_t& index : mesh.indices)
+	{
+		if (remap[index] == unused)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	// Vertices no triangle uses are dropped
+	Mesh reordered;
+	reordered.positions.resize(next);
+	reordered.normals.resize(mesh.normals.empty() ? 0 : next);
+	reordered.uvs.resize(mesh.uvs.empty() ? 0 : next);
+	reordered.tangents.resize(mesh.tangents.empty() ? 0 : next);
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		if (remap[v] == unused)
+			continue;
+		reordered.positions[remap[v]] = mesh.positions[v];
+		if (!mesh.normals.empty())
+			reordered.normals[remap[v]] = mesh.normals[v];
+		if (!mesh.uvs.empty())
+			reordered.uvs[remap[v]] = mesh.uvs[v];
+		if (!mesh.tangents.empty())
+			reordered.tangents[remap[v]] = mesh.tangents[v];
+	}
+	mesh.positions.swap(reordered.positions);
+	mesh.normals.swap(reordered.normals);
+	mesh.uvs.swap(reordered.uvs);
+	mesh.tangents.swap(reordered.tangents);
+}
+
+void optimizeMesh(Mesh& mesh)
+{
+	Timer timer;
+	const VertexCacheStats before = analyzeVertexCache(mesh.indices, mesh.vertexCount());
+
+	optimizeVertexCache(mesh.indices, mesh.vertexCount());
+	optimizeOverdraw(mesh.indices, mesh.positions);
+	buildMeshlets(mesh);
+	optimizeVertexFetch(mesh);
+
+	const VertexCacheStats after = analyzeVertexCache(mesh.indices, mesh.vertexCount());
+	printf("Optimized %zu triangles in %.3f s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (FIFO 16), %zu meshlets\n",
+		mesh.triangleCount(), timer.elapsed(), before.acmr, after.acmr, before.atvr, after.atvr, mesh.meshlets.size());
+}
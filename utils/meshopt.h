@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+struct VertexCacheStats
+{
+	float acmr = 0.f; // average cache miss ratio: transformed vertices per triangle
+	float atvr = 0.f; // average transformed to vertex ratio: 1 is optimal
+};
+
+// Simulates a FIFO post-transform cache of cacheSize entries
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize = 16);
+
+// Reorders triangles for the post-transform cache (Tom Forsyth's linear-speed
+// vertex cache optimisation)
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Reorders cache-optimized triangles to reduce overdraw from any view: the
+// list is cut in clusters wherever it barely costs cache efficiency (ACMR
+// within threshold of the cluster's), then clusters facing outwards from the
+// mesh center are drawn first since they are the likeliest occluders
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use so vertex fetches stay sequential
+void optimizeVertexFetch(Mesh& mesh);
+
+// Runs the three passes above, splitting the triangles in meshlets before
+// vertices get renumbered, and prints the cache statistics before and after
+void optimizeMesh(Mesh& mesh);
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mipmap.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const size_t kRowsPerJob = 16;
+const int kKaiserTaps = 6;
+const int kEncodeSteps = 16384; // linear to sRGB table, fine enough for a fifth of a step near black
+
+// Float RGBA texel, one SSE register
+#ifdef MIPMAP_SSE
+typedef __m128 Texel;
+inline Texel load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Texel t) { _mm_storeu_ps(p, t); }
+inline Texel add(Texel a, Texel b) { return _mm_add_ps(a, b); }
+inline Texel scale(Texel a, float s) { return _mm_mul_ps(a, _mm_set1_ps(s)); }
+#else
+struct Texel { float v[4]; };
+inline Texel load(const float* p) { Texel t; memcpy(t.v, p, sizeof(t.v)); return t; }
+inline void store(float* p, Texel t) { memcpy(p, t.v, sizeof(t.v)); }
+inline Texel add(Texel a, Texel b) { for (int c = 0; c < 4; c++) a.v[c] += b.v[c]; return a; }
+inline Texel scale(Texel a, float s) { for (int c = 0; c < 4; c++) a.v[c] *= s; return a; }
+#endif
+
+struct Tables
+{
+	float decode[256];                // sRGB byte to linear
+	uint8_t encode[kEncodeSteps + 1]; // linear to sRGB byte
+	float kaiser[kKaiserTaps];        // at 2.5, 1.5, 0.5, 0.5, 1.5, 2.5 source texels
+
+	Tables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			const float v = i / 255.f;
+			decode[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= kEncodeSteps; i++)
+		{
+			const float v = (float)i / kEncodeSteps;
+			const float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+			encode[i] = (uint8_t)std::lround(std::min(std::max(s, 0.f), 1.f) * 255.f);
+		}
+
+		// sinc at the destination spacing, windowed over three source texels
+		auto bessel0 = [](double x)
+		{
+			double sum = 1.0, term = 1.0;
+			for (int k = 1; k < 20; k++)
+			{
+				term *= (x / (2 * k)) * (x / (2 * k));
+				sum += term;
+			}
+			return sum;
+		};
+		const double beta = 4.0, pi = 3.14159265358979323846;
+		double total = 0.0;
+		for (int i = 0; i < kKaiserTaps; i++)
+		{
+			const double d = std::abs(i - 2.5), x = d / 2.0;
+			const double sinc = std::sin(pi * x) / (pi * x);
+			const double window = bessel0(beta * std::sqrt(std::max(0.0, 1.0 - (d / 3.0) * (d / 3.0)))) / bessel0(beta);
+			kaiser[i] = (float)(sinc * window);
+			total += kaiser[i];
+		}
+		for (float& weight : kaiser)
+			weight = (float)(weight / total);
+	}
+};
+
+const Tables& tables()
+{
+	static const Tables instance;
+	return instance;
+}
+
+// Linear float copy of a level (but for alpha, and colors when not srgb)
+struct FloatLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<float> texels;
+
+	const float* at(uint32_t x, uint32_t y) const { return &texels[((size_t)y * width + x) * 4]; }
+};
+
+void forRows(uint32_t rows, const std::function<void(uint32_t)>& body)
+{
+	ThreadPool::shared().parallelFor((rows + kRowsPerJob - 1) / kRowsPerJob, [&](size_t job)
+	{
+		const uint32_t last = std::min<uint32_t>((uint32_t)((job + 1) * kRowsPerJob), rows);
+		for (uint32_t y = (uint32_t)(job * kRowsPerJob); y < last; y++)
+			body(y);
+	});
+}
+
+FloatLevel toFloat(const ImageLevel& level, bool srgb)
+{
+	const Tables& table = tables();
+	FloatLevel result;
+	result.width = level.width;
+	result.height = level.height;
+	result.texels.resize(level.pixels.size());
+	forRows(level.height, [&](uint32_t y)
+	{
+		const size_t begin = (size_t)y * level.width * 4, end = begin + (size_t)level.width * 4;
+		for (size_t i = begin; i < end; i += 4)
+		{
+			for (int c = 0; c < 3; c++)
+				result.texels[i + c] = srgb ? table.decode[level.pixels[i + c]] : level.pixels[i + c] / 255.f;
+			result.texels[i + 3] = level.pixels[i + 3] / 255.f;
+		}
+	});
+	return result;
+}
+
+ImageLevel toBytes(const FloatLevel& level, bool srgb)
+{
+	const Tables& table = tables();
+	ImageLevel result;
+	result.width = level.width;
+	result.height = level.height;
+	result.pixels.resize(level.texels.size());
+	const float colorSteps = srgb ? (float)kEncodeSteps : 255.f;
+	forRows(level.height, [&](uint32_t y)
+	{
+		const size_t begin = (size_t)y * level.width * 4, end = begin + (size_t)level.width * 4;
+		for (size_t i = begin; i < end; i += 4)
+		{
+			int steps[4];
+#ifdef MIPMAP_SSE
+			const __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&level.texels[i]), _mm_setzero_ps()), _mm_set1_ps(1.f));
+			const __m128i rounded = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_setr_ps(colorSteps, colorSteps, colorSteps, 255.f)));
+			_mm_storeu_si128((__m128i*)steps, rounded);
+#else
+			for (int c = 0; c < 4; c++)
+				steps[c] = (int)std::lround(std::min(std::max(level.texels[i + c], 0.f), 1.f) * (c < 3 ? colorSteps : 255.f));
+#endif
+			for (int c = 0; c < 3; c++)
+				result.pixels[i + c] = srgb ? table.encode[steps[c]] : (uint8_t)steps[c];
+			result.pixels[i + 3] = (uint8_t)steps[3];
+		}
+	});
+	return result;
+}
+
+FloatLevel downsampleBox(const FloatLevel& source)
+{
+	FloatLevel level;
+	level.width = std::max(1u, source.width / 2);
+	level.height = std::max(1u, source.height / 2);
+	level.texels.resize((size_t)level.width * level.height * 4);
+
+	// A 1-texel wide side is averaged with itself
+	const uint32_t dx = source.width > 1 ? 1 : 0;
+	const uint32_t dy = source.height > 1 ? 1 : 0;
+	forRows(level.height, [&](uint32_t y)
+	{
+		float* out = &level.texels[(size_t)y * level.width * 4];
+		for (uint32_t x = 0; x < level.width; x++, out += 4)
+		{
+			const Texel top = add(load(source.at(x * 2, y * 2)), load(source.at(x * 2 + dx, y * 2)));
+			const Texel bottom = add(load(source.at(x * 2, y * 2 + dy)), load(source.at(x * 2 + dx, y * 2 + dy)));
+			store(out, scale(add(top, bottom), 0.25f));
+		}
+	});
+	return level;
+}
+
+// Separable: rows are filtered horizontally first, then columns
+FloatLevel downsampleKaiser(const FloatLevel& source)
+{
+	const float* weights = tables().kaiser;
+	FloatLevel level;
+	level.width = std::max(1u, source.width / 2);
+	level.height = std::max(1u, source.height / 2);
+	level.texels.resize((size_t)level.width * level.height * 4);
+
+	FloatLevel rows;
+	rows.width = level.width;
+	rows.height = source.height;
+	rows.texels.resize((size_t)rows.width * rows.height * 4);
+	forRows(rows.height, [&](uint32_t y)
+	{
+		float* out = &rows.texels[(size_t)y * rows.width * 4];
+		for (uint32_t x = 0; x < rows.width; x++, out += 4)
+		{
+			Texel sum;
+			for (int k = 0; k < kKaiserTaps; k++)
+			{
+				const int sx = std::min(std::max((int)(x * 2) + k - 2, 0), (int)source.width - 1);
+				const Texel tap = scale(load(source.at(sx, y)), weights[k]);
+				sum = k == 0 ? tap : add(sum, tap);
+			}
+			store(out, sum);
+		}
+	});
+	forRows(level.height, [&](uint32_t y)
+	{
+		int sy[kKaiserTaps];
+		for (int k = 0; k < kKaiserTaps; k++)
+			sy[k] = std::min(std::max((int)(y * 2) + k - 2, 0), (int)rows.height - 1);
+		float* out = &level.texels[(size_t)y * level.width * 4];
+		for (uint32_t x = 0; x < level.width; x++, out += 4)
+		{
+			Texel sum = scale(load(rows.at(x, sy[0])), weights[0]);
+			for (int k = 1; k < kKaiserTaps; k++)
+				sum = add(sum, scale(load(rows.at(x, sy[k])), weights[k]));
+			store(out, sum);
+		}
+	});
+	return level;
+}
+
+}
+
+std::vector<ImageLevel> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, MipFilter filter, bool srgb)
+{
+	std::vector<ImageLevel> levels(1);
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+	FloatLevel current = toFloat(levels[0], srgb);
+	while (current.width > 1 || current.height > 1)
+	{
+		current = filter == MipFilter::Kaiser ? downsampleKaiser(current) : downsampleBox(current);
+		levels.push_back(toBytes(current, srgb));
+	}
+	return levels;
+}
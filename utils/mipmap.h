@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// One level of an RGBA8 image, rows in the order of the image (top to bottom
+// as stb_image decodes them, which is how cookTexture stores them)
+struct ImageLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+enum class MipFilter
+{
+	Box,   // 2x2 average
+	Kaiser // 6x6 Kaiser-windowed sinc, sharper
+};
+
+// Mip chain down to 1x1, level 0 being the image itself; odd sizes drop
+// their last row or column. With srgb, colors are filtered in linear space
+// (alpha always is). Levels are built from a float copy of the previous one,
+// in rows spread over the shared thread pool, with SSE2 when available.
+std::vector<ImageLevel> buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height,
+	MipFilter filter = MipFilter::Kaiser, bool srgb = true);
@@ -2,115 +2,637 @@
 #include <stdio.h>
 #include <string>
 #include <cstring>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
 
 #include <glm/glm.hpp>
 
 #include "objloader.hpp"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+#include "tangentspace.h"
 
 // Very, VERY simple OBJ loader.
 // Here is a short list of features a real function would provide : 
 // - Binary files. Reading a model should be just a few memcpy's away, not parsing a file at runtime. In short : OBJ is not very great.
 // - Animations & bones (includes bones weights)
 // - Multiple UVs
-// - All attributes should be optional, not "forced"
 // - More stable. Change a line in the OBJ file and it crashes.
 // - More secure. Change another line and you can inject code.
 // - Loading from memory, stream, etc
 
-bool loadOBJ(
-	const char* path,
-	std::vector<glm::vec3>& out_vertices,
-	std::vector<glm::vec2>& out_uvs,
-	std::vector<glm::vec3>& out_normals
-) {
-	printf("Loading OBJ file %s...\n", path);
+namespace {
 
-	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
+struct ObjCorner {
+	unsigned int v, vt, vn;
+};
 
+// Attribute a face corner does not give ("v", "v/vt" and "v//vn" forms)
+const unsigned int kNoIndex = ~0u;
+// Index 0, invalid in OBJ files: out of range whatever the attribute count
+const unsigned int kBadIndex = kNoIndex - 1;
 
-	FILE* file = fopen(path, "r");
-	if (file == NULL) {
-		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-		getchar();
+struct ObjData {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners; // three per triangle, zero-based
+};
+
+inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+	while (p < end && isBlank(*p))
+		++p;
+	return p;
+}
+
+inline const char* nextLine(const char* p, const char* end)
+{
+	const char* eol = (const char*)memchr(p, '\n', end - p);
+	return eol ? eol + 1 : end;
+}
+
+inline bool isDigit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+// Decimal float parser in the spirit of std::from_chars: no locale, no
+// allocation, stops at the first character that is not part of the number.
+// Up to 19 significant digits are kept exactly, which is more than a float needs.
+bool parseFloat(const char*& p, const char* end, float& out)
+{
+	static const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* s = skipBlanks(p, end);
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false;
+
+	for (; s < end && isDigit(*s); ++s, any = true)
+	{
+		if (digits < 19) { mantissa = mantissa * 10 + (*s - '0'); if (mantissa) ++digits; }
+		else ++exponent;
+	}
+	if (s < end && *s == '.')
+	{
+		for (++s; s < end && isDigit(*s); ++s, any = true)
+		{
+			if (digits < 19) { mantissa = mantissa * 10 + (*s - '0'); if (mantissa) ++digits; --exponent; }
+		}
+	}
+	if (!any)
 		return false;
+
+	if (s < end && (*s == 'e' || *s == 'E'))
+	{
+		const char* e = s + 1;
+		bool negativeExp = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			negativeExp = *e++ == '-';
+		if (e < end && isDigit(*e))
+		{
+			int value = 0;
+			for (; e < end && isDigit(*e); ++e)
+				if (value < 10000) value = value * 10 + (*e - '0');
+			exponent += negativeExp ? -value : value;
+			s = e;
+		}
 	}
 
-	while (1) {
+	double value = (double)mantissa;
+	if (exponent < 0)
+		value = exponent >= -22 ? value / powersOf10[-exponent] : value * std::pow(10.0, exponent);
+	else if (exponent > 0)
+		value = exponent <= 22 ? value * powersOf10[exponent] : value * std::pow(10.0, exponent);
 
-		char lineHeader[128];
-		// read the first word of the line
-		int res = fscanf(file, "%s", lineHeader);
-		if (res == EOF)
-			break; // EOF = End Of File. Quit the loop.
+	out = (float)(negative ? -value : value);
+	p = s;
+	return true;
+}
 
-		// else : parse lineHeader
+bool parseInt(const char*& p, const char* end, long& out)
+{
+	const char* s = p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+	if (s == end || !isDigit(*s))
+		return false;
+	long value = 0;
+	for (; s < end && isDigit(*s); ++s)
+		value = value * 10 + (*s - '0');
+	out = negative ? -value : value;
+	p = s;
+	return true;
+}
+
+// Parse results of one line-aligned slice of the file. Absolute indices are
+// final as soon as they are read, but relative (negative) ones depend on how
+// many attributes the previous chunks hold: they are stored relative to the
+// start of the chunk and listed in fixups until the chunks are merged.
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+	ObjData data;
+	std::vector<size_t> fixups; // corner * 3 + attribute
+	size_t lines = 0;
+	const char* error = nullptr;
+};
+
+const size_t kMinChunkSize = 4 << 20;
+const size_t kCornersPerJob = 1 << 16;
+
+// Relative indices are stored as the signed offset from the start of the
+// chunk, negative when they point into an earlier one
+inline unsigned int readIndex(long index, size_t localCount, bool& relative)
+{
+	relative = index < 0;
+	if (index == 0 || index < -(long)INT_MAX)
+	{
+		relative = false;
+		return kBadIndex;
+	}
+	return (unsigned int)(relative ? (long)localCount + index : index - 1);
+}
 
-		if (strcmp(lineHeader, "v") == 0) {
+// Parses one "v", "v/vt", "v//vn" or "v/vt/vn" face corner, leaving the
+// attributes it lacks to kNoIndex. Bits of relative tell which of its
+// indices are relative to the start of the chunk.
+bool parseCorner(const char*& p, const char* end, const ObjData& data, ObjCorner& corner, unsigned& relative)
+{
+	long v, vt, vn;
+	bool hasUV = false, hasNormal = false;
+	const char* s = p;
+	if (!parseInt(s, end, v))
+		return false;
+	if (s < end && *s == '/')
+	{
+		++s;
+		if (s < end && *s != '/')
+		{
+			if (!parseInt(s, end, vt))
+				return false;
+			hasUV = true;
+		}
+		if (s < end && *s == '/')
+		{
+			++s;
+			if (!parseInt(s, end, vn))
+				return false;
+			hasNormal = true;
+		}
+	}
+
+	bool r0, r1 = false, r2 = false;
+	corner.v = readIndex(v, data.positions.size(), r0);
+	corner.vt = hasUV ? readIndex(vt, data.uvs.size(), r1) : kNoIndex;
+	corner.vn = hasNormal ? readIndex(vn, data.normals.size(), r2) : kNoIndex;
+	relative = r0 | r1 << 1 | r2 << 2;
+	p = s;
+	return true;
+}
+
+void pushCorner(ObjChunk& chunk, const ObjCorner& corner, unsigned relative)
+{
+	const size_t slot = chunk.data.corners.size() * 3;
+	for (unsigned attribute = 0; attribute < 3; attribute++)
+		if (relative & (1u << attribute))
+			chunk.fixups.push_back(slot + attribute);
+	chunk.data.corners.push_back(corner);
+}
+
+// Cheap first pass: counts records so the real pass never reallocates
+void reserveOBJ(const char* p, const char* end, ObjData& data)
+{
+	size_t positions = 0, uvs = 0, normals = 0, faces = 0;
+	while (p < end)
+	{
+		if (end - p >= 2)
+		{
+			if (p[0] == 'v')
+			{
+				if (isBlank(p[1])) ++positions;
+				else if (p[1] == 't') ++uvs;
+				else if (p[1] == 'n') ++normals;
+			}
+			else if (p[0] == 'f' && isBlank(p[1]))
+				++faces;
+		}
+		p = nextLine(p, end);
+	}
+	data.positions.reserve(positions);
+	data.uvs.reserve(uvs);
+	data.normals.reserve(normals);
+	data.corners.reserve(faces * 3);
+}
+
+void parseChunk(ObjChunk& chunk)
+{
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+	ObjData& data = chunk.data;
+
+	reserveOBJ(p, end, data);
+
+	for (; p < end; p = nextLine(p, end), ++chunk.lines)
+	{
+		const char* s = skipBlanks(p, end);
+		if (end - s < 2)
+			continue;
+
+		if (s[0] == 'v' && isBlank(s[1]))
+		{
 			glm::vec3 vertex;
-			fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-			temp_vertices.push_back(vertex);
+			s += 1;
+			if (!parseFloat(s, end, vertex.x) || !parseFloat(s, end, vertex.y) || !parseFloat(s, end, vertex.z))
+				break;
+			data.positions.push_back(vertex);
 		}
-		else if (strcmp(lineHeader, "vt") == 0) {
+		else if (s[0] == 'v' && s[1] == 't')
+		{
 			glm::vec2 uv;
-			fscanf(file, "%f %f\n", &uv.x, &uv.y);
-			// uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
-			temp_uvs.push_back(uv);
+			s += 2;
+			if (!parseFloat(s, end, uv.x) || !parseFloat(s, end, uv.y))
+				break;
+			data.uvs.push_back(uv);
 		}
-		else if (strcmp(lineHeader, "vn") == 0) {
+		else if (s[0] == 'v' && s[1] == 'n')
+		{
 			glm::vec3 normal;
-			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-			temp_normals.push_back(normal);
-		}
-		else if (strcmp(lineHeader, "f") == 0) {
-			std::string vertex1, vertex2, vertex3;
-			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-			if (matches != 9) {
-				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-				fclose(file);
-				return false;
+			s += 2;
+			if (!parseFloat(s, end, normal.x) || !parseFloat(s, end, normal.y) || !parseFloat(s, end, normal.z))
+				break;
+			data.normals.push_back(normal);
+		}
+		else if (s[0] == 'f' && isBlank(s[1]))
+		{
+			// Polygons are triangulated as a fan around their first corner
+			ObjCorner first, previous, corner;
+			unsigned firstRelative = 0, previousRelative = 0, relative;
+			int count = 0;
+			s = skipBlanks(s + 1, end);
+			while (s < end && *s != '\n' && *s != '#')
+			{
+				if (!parseCorner(s, end, data, corner, relative))
+				{
+					chunk.error = "File can't be read by our simple parser :-( Try exporting with other options";
+					return;
+				}
+				if (count == 0)
+				{
+					first = corner;
+					firstRelative = relative;
+				}
+				else if (count >= 2)
+				{
+					pushCorner(chunk, first, firstRelative);
+					pushCorner(chunk, previous, previousRelative);
+					pushCorner(chunk, corner, relative);
+				}
+				previous = corner;
+				previousRelative = relative;
+				++count;
+				s = skipBlanks(s, end);
+			}
+			if (count < 3)
+			{
+				chunk.error = "Face with less than three corners";
+				return;
+			}
+		}
+		// Anything else is a comment or a record we don't support: skip the line
+	}
+
+	if (p < end)
+		chunk.error = "Malformed vertex attribute";
+}
+
+// Cuts [begin, end) into roughly equal slices that start at a line boundary
+std::vector<ObjChunk> splitOBJ(const char* begin, const char* end, size_t count)
+{
+	std::vector<ObjChunk> chunks;
+	chunks.reserve(count);
+	const size_t size = end - begin;
+	const char* p = begin;
+	for (size_t i = 1; i <= count && p < end; i++)
+	{
+		const char* next = i == count ? end : nextLine(std::max(p, begin + size / count * i), end);
+		ObjChunk chunk;
+		chunk.begin = p;
+		chunk.end = next;
+		chunks.push_back(std::move(chunk));
+		p = next;
+	}
+	return chunks;
+}
+
+// Concatenates the chunks, shifting their relative indices by the number of
+// attributes the previous chunks hold (an exclusive prefix sum over the counts)
+bool mergeChunks(std::vector<ObjChunk>& chunks, ObjData& data, unsigned threads)
+{
+	size_t line = 1;
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (chunk.error)
+		{
+			printf("%s (line %zu)\n", chunk.error, line + chunk.lines);
+			return false;
+		}
+		line += chunk.lines;
+	}
+
+	struct Offsets { size_t positions = 0, uvs = 0, normals = 0, corners = 0; };
+	std::vector<Offsets> offsets(chunks.size() + 1);
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		const ObjData& c = chunks[i].data;
+		offsets[i + 1].positions = offsets[i].positions + c.positions.size();
+		offsets[i + 1].uvs = offsets[i].uvs + c.uvs.size();
+		offsets[i + 1].normals = offsets[i].normals + c.normals.size();
+		offsets[i + 1].corners = offsets[i].corners + c.corners.size();
+	}
+	const Offsets& total = offsets.back();
+
+	if (chunks.size() == 1)
+	{
+		data = std::move(chunks[0].data);
+	}
+	else
+	{
+		data.positions.resize(total.positions);
+		data.uvs.resize(total.uvs);
+		data.normals.resize(total.normals);
+		data.corners.resize(total.corners);
+	}
+
+	std::atomic<bool> valid{ true };
+	ThreadPool::shared().parallelFor(chunks.size(), [&](size_t i)
+	{
+		ObjChunk& chunk = chunks[i];
+		const Offsets& base = offsets[i];
+		ObjCorner* corners = chunks.size() == 1 ? data.corners.data() : chunk.data.corners.data();
+
+		for (size_t slot : chunk.fixups)
+		{
+			unsigned int* index = &corners[slot / 3].v + slot % 3;
+			const size_t start = slot % 3 == 0 ? base.positions : slot % 3 == 1 ? base.uvs : base.normals;
+			const int64_t resolved = (int64_t)start + (int32_t)*index;
+			if (resolved < 0)
+			{
+				// Before the first attribute of the file
+				valid = false;
+				return;
 			}
-			vertexIndices.push_back(vertexIndex[0]);
-			vertexIndices.push_back(vertexIndex[1]);
-			vertexIndices.push_back(vertexIndex[2]);
-			uvIndices.push_back(uvIndex[0]);
-			uvIndices.push_back(uvIndex[1]);
-			uvIndices.push_back(uvIndex[2]);
-			normalIndices.push_back(normalIndex[0]);
-			normalIndices.push_back(normalIndex[1]);
-			normalIndices.push_back(normalIndex[2]);
+			*index = (unsigned int)resolved;
 		}
-		else {
-			// Probably a comment, eat up the rest of the line
-			char stupidBuffer[1000];
-			fgets(stupidBuffer, 1000, file);
+
+		const size_t count = offsets[i + 1].corners - base.corners;
+		for (size_t c = 0; c < count; c++)
+		{
+			if (corners[c].v >= total.positions
+				|| (corners[c].vt >= total.uvs && corners[c].vt != kNoIndex)
+				|| (corners[c].vn >= total.normals && corners[c].vn != kNoIndex))
+			{
+				valid = false;
+				return;
+			}
+		}
+
+		if (chunks.size() > 1)
+		{
+			const ObjData& c = chunk.data;
+			std::copy(c.positions.begin(), c.positions.end(), data.positions.begin() + base.positions);
+			std::copy(c.uvs.begin(), c.uvs.end(), data.uvs.begin() + base.uvs);
+			std::copy(c.normals.begin(), c.normals.end(), data.normals.begin() + base.normals);
+			std::copy(c.corners.begin(), c.corners.end(), data.corners.begin() + base.corners);
+			chunk.data = ObjData();
 		}
+	}, threads);
+
+	if (!valid)
+	{
+		printf("Face index out of range\n");
+		return false;
+	}
+	return true;
+}
 
+// Corners without a normal get the smooth one of their position, generated
+// from every face, and those without uvs share a (0, 0) one
+void completeOBJ(ObjData& data)
+{
+	bool missingUVs = false, missingNormals = false;
+	for (const ObjCorner& corner : data.corners)
+	{
+		missingUVs |= corner.vt == kNoIndex;
+		missingNormals |= corner.vn == kNoIndex;
 	}
 
-	// For each vertex of each triangle
-	for (unsigned int i = 0; i < vertexIndices.size(); i++) {
+	if (missingNormals)
+	{
+		std::vector<uint32_t> indices(data.corners.size());
+		for (size_t i = 0; i < indices.size(); i++)
+			indices[i] = data.corners[i].v;
+		const size_t base = data.normals.size();
+		data.normals.resize(base + data.positions.size());
+		generateNormals(data.positions.data(), data.positions.size(), indices.data(), indices.size(), &data.normals[base]);
+		for (ObjCorner& corner : data.corners)
+			if (corner.vn == kNoIndex)
+				corner.vn = (unsigned int)(base + corner.v);
+	}
 
-		// Get the indices of its attributes
-		unsigned int vertexIndex = vertexIndices[i];
-		unsigned int uvIndex = uvIndices[i];
-		unsigned int normalIndex = normalIndices[i];
+	if (missingUVs)
+	{
+		const unsigned int uv = (unsigned int)data.uvs.size();
+		data.uvs.push_back(glm::vec2(0.f));
+		for (ObjCorner& corner : data.corners)
+			if (corner.vt == kNoIndex)
+				corner.vt = uv;
+	}
+}
 
-		// Get the attributes thanks to the index
-		glm::vec3 vertex = temp_vertices[vertexIndex - 1];
-		glm::vec2 uv = temp_uvs[uvIndex - 1];
-		glm::vec3 normal = temp_normals[normalIndex - 1];
+bool parseOBJ(const char* begin, const char* end, ObjData& data, unsigned threads)
+{
+	ThreadPool& pool = ThreadPool::shared();
+	if (threads == 0)
+		threads = pool.size() + 1;
 
-		// Put the attributes in buffers
-		out_vertices.push_back(vertex);
-		out_uvs.push_back(uv);
-		out_normals.push_back(normal);
+	// A few chunks per thread evens out files whose records are not uniform
+	size_t count = 1;
+	if (threads > 1)
+		count = std::max<size_t>(1, std::min<size_t>(threads * 4, (end - begin) / kMinChunkSize));
+
+	std::vector<ObjChunk> chunks = splitOBJ(begin, end, count);
+	pool.parallelFor(chunks.size(), [&](size_t i) { parseChunk(chunks[i]); }, threads);
+	if (!mergeChunks(chunks, data, threads))
+		return false;
+	completeOBJ(data);
+	return true;
+}
+
+inline uint32_t hashCorner(const ObjCorner& c)
+{
+	uint32_t h = c.v * 0x9E3779B1u;
+	h ^= c.vt * 0x85EBCA77u + (h << 6) + (h >> 2);
+	h ^= c.vn * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+	return h ^ (h >> 15);
+}
 
+// Gives every distinct (position, uv, normal) triple its own vertex. The
+// open-addressing table stores vertex indices and compares through the
+// corners they were created from.
+void indexOBJ(const ObjData& data, Mesh& mesh)
+{
+	const uint32_t empty = ~0u;
+	std::vector<ObjCorner> unique;
+	unique.reserve(data.positions.size());
+
+	size_t capacity = 64;
+	while (capacity < data.positions.size() * 2)
+		capacity *= 2;
+	std::vector<uint32_t> table(capacity, empty);
+
+	mesh.indices.resize(data.corners.size());
+	for (size_t i = 0; i < data.corners.size(); i++)
+	{
+		const ObjCorner& corner = data.corners[i];
+		size_t mask = table.size() - 1;
+		size_t slot = hashCorner(corner) & mask;
+		while (table[slot] != empty)
+		{
+			const ObjCorner& other = unique[table[slot]];
+			if (other.v == corner.v && other.vt == corner.vt && other.vn == corner.vn)
+				break;
+			slot = (slot + 1) & mask;
+		}
+
+		if (table[slot] == empty)
+		{
+			table[slot] = (uint32_t)unique.size();
+			unique.push_back(corner);
+
+			// Keep the load factor under one half
+			if (unique.size() * 2 > table.size())
+			{
+				std::vector<uint32_t> grown(table.size() * 2, empty);
+				mask = grown.size() - 1;
+				for (uint32_t vertex = 0; vertex < unique.size(); vertex++)
+				{
+					size_t s = hashCorner(unique[vertex]) & mask;
+					while (grown[s] != empty)
+						s = (s + 1) & mask;
+					grown[s] = vertex;
+				}
+				table.swap(grown);
+			}
+			mesh.indices[i] = (uint32_t)unique.size() - 1;
+		}
+		else
+			mesh.indices[i] = table[slot];
 	}
-	fclose(file);
+
+	mesh.positions.resize(unique.size());
+	mesh.uvs.resize(unique.size());
+	mesh.normals.resize(unique.size());
+	for (size_t i = 0; i < unique.size(); i++)
+	{
+		mesh.positions[i] = data.positions[unique[i].v];
+		mesh.uvs[i] = data.uvs[unique[i].vt];
+		mesh.normals[i] = data.normals[unique[i].vn];
+	}
+}
+
+bool readOBJ(const char* path, ObjData& data, const ObjLoadOptions& options, size_t& fileSize)
+{
+	printf("Loading OBJ file %s...\n", path);
+
+	MappedFile file(path);
+	if (!file.isOpen()) {
+		// No getchar(): this runs on loader threads and in assetcook
+		printf("Impossible to open the file %s\n", path);
+		return false;
+	}
+	fileSize = file.size();
+	return parseOBJ(file.data(), file.data() + file.size(), data, options.threads);
+}
+
+void printThroughput(size_t triangles, size_t fileSize, float seconds)
+{
+	const double megabytes = fileSize / (1024.0 * 1024.0);
+	printf("Loaded %zu triangles from %.1f MB in %.3f s (%.0f MB/s)\n", triangles, megabytes, seconds, seconds > 0.f ? megabytes / seconds : 0.0);
+}
+
+}
+
+bool loadOBJ(
+	const char* path,
+	std::vector<glm::vec3>& out_vertices,
+	std::vector<glm::vec2>& out_uvs,
+	std::vector<glm::vec3>& out_normals,
+	const ObjLoadOptions& options
+) {
+	Timer timer;
+
+	ObjData data;
+	size_t fileSize;
+	if (!readOBJ(path, data, options, fileSize))
+		return false;
+
+	// For each vertex of each triangle, put its attributes in the buffers
+	const size_t first = out_vertices.size();
+	const size_t count = data.corners.size();
+	out_vertices.resize(first + count);
+	out_uvs.resize(first + count);
+	out_normals.resize(first + count);
+	ThreadPool::shared().parallelFor((count + kCornersPerJob - 1) / kCornersPerJob, [&](size_t job)
+	{
+		const size_t last = std::min(count, (job + 1) * kCornersPerJob);
+		for (size_t i = job * kCornersPerJob; i < last; i++) {
+			const ObjCorner& corner = data.corners[i];
+			out_vertices[first + i] = data.positions[corner.v];
+			out_uvs[first + i] = data.uvs[corner.vt];
+			out_normals[first + i] = data.normals[corner.vn];
+		}
+	}, options.threads);
+
+	printThroughput(count / 3, fileSize, timer.elapsed());
+	return true;
+}
+
+bool loadOBJ(
+	const char* path,
+	Mesh& mesh,
+	const ObjLoadOptions& options
+) {
+	Timer timer;
+
+	ObjData data;
+	size_t fileSize;
+	if (!readOBJ(path, data, options, fileSize))
+		return false;
+
+	indexOBJ(data, mesh);
+
+	printThroughput(mesh.triangleCount(), fileSize, timer.elapsed());
+	printf("Indexed %zu corners into %zu unique vertices (%.1fx fewer)\n", data.corners.size(), mesh.vertexCount(),
+		mesh.vertexCount() ? (double)data.corners.size() / mesh.vertexCount() : 0.0);
 	return true;
 }
 
@@ -4,11 +4,29 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "mesh.h"
+
+struct ObjLoadOptions
+{
+	// Threads used to parse the file: 0 uses every core,
+	// 1 forces the single-threaded path (e.g. for determinism tests)
+	unsigned threads = 0;
+};
+
 bool loadOBJ(
 	const char* path,
 	std::vector<glm::vec3>& out_vertices,
 	std::vector<glm::vec2>& out_uvs,
-	std::vector<glm::vec3>& out_normals
+	std::vector<glm::vec3>& out_normals,
+	const ObjLoadOptions& options = ObjLoadOptions()
+);
+
+// Indexed variant: corners sharing the same position, uv and normal
+// indices become a single vertex
+bool loadOBJ(
+	const char* path,
+	Mesh& mesh,
+	const ObjLoadOptions& options = ObjLoadOptions()
 );
 
 
@@ -0,0 +1,280 @@
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <stdio.h>
+#include <streambuf>
+#include <string>
+
+#include <tinyply.h>
+
+#include "plyloader.h"
+#include "MappedFile.h"
+#include "tangentspace.h"
+#include "Timer.h"
+
+namespace {
+
+// Lets tinyply read from the mapped file without copying it into a stream first
+struct MemoryBuffer : std::streambuf
+{
+	MemoryBuffer(const char* data, size_t size)
+	{
+		char* begin = const_cast<char*>(data);
+		setg(begin, begin, begin + size);
+	}
+
+	pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode) override
+	{
+		char* target = dir == std::ios_base::beg ? eback() + offset
+			: dir == std::ios_base::cur ? gptr() + offset
+			: egptr() + offset;
+		if (target < eback() || target > egptr())
+			return pos_type(off_type(-1));
+		setg(eback(), target, egptr());
+		return pos_type(target - eback());
+	}
+
+	pos_type seekpos(pos_type position, std::ios_base::openmode mode) override
+	{
+		return seekoff(off_type(position), std::ios_base::beg, mode);
+	}
+};
+
+bool hasProperty(const tinyply::PlyElement& element, const char* name)
+{
+	for (const tinyply::PlyProperty& property : element.properties)
+		if (property.name == name)
+			return true;
+	return false;
+}
+
+// First of the candidate property pairs or triples the element has
+const char* const* findProperties(const tinyply::PlyElement& element, const char* const (*candidates)[3], size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		bool found = true;
+		for (int k = 0; k < 3 && candidates[i][k]; k++)
+			found = found && hasProperty(element, candidates[i][k]);
+		if (found)
+			return candidates[i];
+	}
+	return nullptr;
+}
+
+std::shared_ptr<tinyply::PlyData> request(tinyply::PlyFile& file, const char* element, const char* const* names)
+{
+	if (!names)
+		return nullptr;
+	std::vector<std::string> keys;
+	for (int k = 0; k < 3 && names[k]; k++)
+		keys.push_back(names[k]);
+	return file.request_properties_from_element(element, keys);
+}
+
+// Copies count * components values into destination, a single memcpy when
+// the file already stores floats
+bool copyFloats(tinyply::PlyData& data, float* destination, size_t count, size_t components)
+{
+	const size_t values = count * components;
+	if (data.count != count)
+		return false;
+	if (data.t == tinyply::Type::FLOAT32)
+	{
+		if (data.buffer.size_bytes() < values * sizeof(float))
+			return false;
+		memcpy(destination, data.buffer.get(), values * sizeof(float));
+		return true;
+	}
+	if (data.t == tinyply::Type::FLOAT64)
+	{
+		if (data.buffer.size_bytes() < values * sizeof(double))
+			return false;
+		const double* source = (const double*)data.buffer.get();
+		for (size_t i = 0; i < values; i++)
+			destination[i] = (float)source[i];
+		return true;
+	}
+	return false;
+}
+
+template <typename T>
+void widen(const uint8_t* source, uint32_t* destination, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		T value;
+		memcpy(&value, source + i * sizeof(T), sizeof(T));
+		destination[i] = (uint32_t)value;
+	}
+}
+
+bool copyIndices(tinyply::PlyData& data, std::vector<uint32_t>& indices)
+{
+	const size_t count = data.count * 3;
+	const uint8_t* source = data.buffer.get();
+	const auto info = tinyply::PropertyTable.find(data.t);
+	if (info == tinyply::PropertyTable.end() || data.buffer.size_bytes() != count * info->second.stride)
+		return false;
+
+	indices.resize(count);
+	switch (data.t)
+	{
+	case tinyply::Type::INT32:
+	case tinyply::Type::UINT32: memcpy(indices.data(), source, count * sizeof(uint32_t)); return true;
+	case tinyply::Type::INT16: widen<int16_t>(source, indices.data(), count); return true;
+	case tinyply::Type::UINT16: widen<uint16_t>(source, indices.data(), count); return true;
+	case tinyply::Type::INT8: widen<int8_t>(source, indices.data(), count); return true;
+	case tinyply::Type::UINT8: widen<uint8_t>(source, indices.data(), count); return true;
+	default: return false;
+	}
+}
+
+}
+
+bool loadPLY(const char* path, Mesh& mesh)
+{
+	Timer timer;
+	printf("Loading PLY file %s...\n", path);
+
+	MappedFile input(path);
+	if (!input.isOpen())
+	{
+		printf("Impossible to open the file %s\n", path);
+		return false;
+	}
+
+	mesh = Mesh();
+	try
+	{
+		MemoryBuffer buffer(input.data(), input.size());
+		std::istream stream(&buffer);
+
+		tinyply::PlyFile file;
+		if (!file.parse_header(stream))
+		{
+			printf("%s is not a PLY file\n", path);
+			return false;
+		}
+
+		static const char* const positionNames[][3] = { { "x", "y", "z" } };
+		static const char* const normalNames[][3] = { { "nx", "ny", "nz" } };
+		static const char* const uvNames[][3] = { { "u", "v" }, { "s", "t" }, { "texture_u", "texture_v" }, { "texture_s", "texture_t" } };
+		static const char* const faceNames[][3] = { { "vertex_indices" }, { "vertex_index" } };
+
+		const char* const* positionKeys = nullptr;
+		const char* const* normalKeys = nullptr;
+		const char* const* uvKeys = nullptr;
+		const char* const* faceKeys = nullptr;
+		for (const tinyply::PlyElement& element : file.get_elements())
+		{
+			if (element.name == "vertex")
+			{
+				positionKeys = findProperties(element, positionNames, 1);
+				normalKeys = findProperties(element, normalNames, 1);
+				uvKeys = findProperties(element, uvNames, 4);
+			}
+			else if (element.name == "face")
+				faceKeys = findProperties(element, faceNames, 2);
+		}
+		if (!positionKeys || !faceKeys)
+		{
+			printf("%s has no vertex positions or no faces\n", path);
+			return false;
+		}
+
+		// Sizes come from the header, so every stream is allocated once;
+		// faces are read as fixed lists of 3 indices
+		std::shared_ptr<tinyply::PlyData> positions = request(file, "vertex", positionKeys);
+		std::shared_ptr<tinyply::PlyData> normals = request(file, "vertex", normalKeys);
+		std::shared_ptr<tinyply::PlyData> uvs = request(file, "vertex", uvKeys);
+		std::shared_ptr<tinyply::PlyData> faces = file.request_properties_from_element("face", { faceKeys[0] }, 3);
+		file.read(stream);
+
+		const size_t vertexCount = positions->count;
+		if (vertexCount == 0)
+		{
+			printf("%s has no vertices\n", path);
+			return false;
+		}
+		mesh.positions.resize(vertexCount);
+		mesh.normals.resize(vertexCount);
+		mesh.uvs.resize(vertexCount, glm::vec2(0.f));
+		bool ok = copyFloats(*positions, (float*)mesh.positions.data(), vertexCount, 3)
+			&& (!normals || copyFloats(*normals, (float*)mesh.normals.data(), vertexCount, 3))
+			&& (!uvs || copyFloats(*uvs, (float*)mesh.uvs.data(), vertexCount, 2));
+		if (!ok || !copyIndices(*faces, mesh.indices))
+		{
+			printf("%s has unsupported property types or faces that are not triangles\n", path);
+			mesh = Mesh();
+			return false;
+		}
+
+		for (uint32_t index : mesh.indices)
+		{
+			if (index >= vertexCount)
+			{
+				printf("Face index out of range in %s\n", path);
+				mesh = Mesh();
+				return false;
+			}
+		}
+
+		if (!normals)
+			computeNormals(mesh);
+	}
+	catch (const std::exception& e)
+	{
+		printf("Could not read %s: %s\n", path, e.what());
+		mesh = Mesh();
+		return false;
+	}
+
+	const float seconds = timer.elapsed();
+	const double megabytes = input.size() / (1024.0 * 1024.0);
+	printf("Loaded %zu triangles from %.1f MB in %.3f s (%.0f MB/s)\n", mesh.triangleCount(), megabytes, seconds, seconds > 0.f ? megabytes / seconds : 0.0);
+	return true;
+}
+
+bool writePLY(const char* path, const Mesh& mesh, bool binary)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	fprintf(file, "ply\nformat %s 1.0\n", binary ? "binary_little_endian" : "ascii");
+	fprintf(file, "element vertex %zu\n", mesh.vertexCount());
+	fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+	fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+	fprintf(file, "property float u\nproperty float v\n");
+	fprintf(file, "element face %zu\n", mesh.triangleCount());
+	fprintf(file, "property list uchar uint vertex_indices\nend_header\n");
+
+	bool ok = true;
+	for (size_t i = 0; i < mesh.vertexCount() && ok; i++)
+	{
+		const glm::vec3& p = mesh.positions[i];
+		const glm::vec3 n = mesh.normals.empty() ? glm::vec3(0.f) : mesh.normals[i];
+		const glm::vec2 t = mesh.uvs.empty() ? glm::vec2(0.f) : mesh.uvs[i];
+		if (binary)
+		{
+			const float vertex[8] = { p.x, p.y, p.z, n.x, n.y, n.z, t.x, t.y };
+			ok = fwrite(vertex, sizeof(vertex), 1, file) == 1;
+		}
+		else
+			ok = fprintf(file, "%g %g %g %g %g %g %g %g\n", p.x, p.y, p.z, n.x, n.y, n.z, t.x, t.y) > 0;
+	}
+	for (size_t i = 0; i < mesh.triangleCount() && ok; i++)
+	{
+		const uint32_t* triangle = &mesh.indices[i * 3];
+		if (binary)
+		{
+			const uint8_t three = 3;
+			ok = fwrite(&three, 1, 1, file) == 1 && fwrite(triangle, sizeof(uint32_t), 3, file) == 3;
+		}
+		else
+			ok = fprintf(file, "3 %u %u %u\n", triangle[0], triangle[1], triangle[2]) > 0;
+	}
+	return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+#include "mesh.h"
+
+// Loads a binary (little or big endian) or ASCII PLY made of triangles.
+// Vertex and face properties are read in bulk into buffers sized from the
+// header. Normals are generated when the file has none, uvs default to 0.
+bool loadPLY(const char* path, Mesh& mesh);
+
+// Writes mesh as a PLY with float x y z nx ny nz u v vertices and
+// uint vertex_indices faces
+bool writePLY(const char* path, const Mesh& mesh, bool binary = true);
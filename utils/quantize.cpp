@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "quantize.h"
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const uint32_t sign = (bits >> 16) & 0x8000u;
+	const uint32_t absolute = bits & 0x7FFFFFFFu;
+
+	// NaN stays NaN, infinity and overflow become infinity
+	if (absolute >= 0x7F800000u)
+		return (uint16_t)(sign | 0x7C00u | (absolute > 0x7F800000u ? 0x200u : 0u));
+	if (absolute >= 0x477FF000u)
+		return (uint16_t)(sign | 0x7C00u);
+
+	// Too small for a normal half: produce a denormal, rounding to nearest even
+	if (absolute < 0x38800000u)
+	{
+		if (absolute < 0x33000000u)
+			return (uint16_t)sign;
+		const uint32_t mantissa = (absolute & 0x007FFFFFu) | 0x00800000u;
+		const int shift = 126 - (int)(absolute >> 23);
+		uint32_t half = mantissa >> shift;
+		const uint32_t remainder = mantissa & ((1u << shift) - 1);
+		const uint32_t midpoint = 1u << (shift - 1);
+		if (remainder > midpoint || (remainder == midpoint && (half & 1)))
+			++half;
+		return (uint16_t)(sign | half);
+	}
+
+	// Rebias the exponent and round the mantissa to nearest even
+	uint32_t half = (absolute - 0x38000000u) >> 13;
+	const uint32_t remainder = absolute & 0x1FFFu;
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1)))
+		++half;
+	return (uint16_t)(sign | half);
+}
+
+float halfToFloat(uint16_t value)
+{
+	const uint32_t sign = (uint32_t)(value & 0x8000u) << 16;
+	const uint32_t exponent = (value >> 10) & 0x1Fu;
+	const uint32_t mantissa = value & 0x3FFu;
+
+	uint32_t bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000u | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else if (mantissa != 0)
+	{
+		// Denormal: normalize it
+		int shift = 0;
+		uint32_t m = mantissa;
+		while (!(m & 0x400u))
+		{
+			m <<= 1;
+			++shift;
+		}
+		bits = sign | ((uint32_t)(113 - shift) << 23) | ((m & 0x3FFu) << 13);
+	}
+	else
+		bits = sign;
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+namespace {
+
+inline float signNotZero(float v)
+{
+	return v >= 0.f ? 1.f : -1.f;
+}
+
+inline int16_t toSnorm16(float v)
+{
+	return (int16_t)std::lround(glm::clamp(v, -1.f, 1.f) * 32767.f);
+}
+
+inline uint16_t toUnorm16(float v)
+{
+	return (uint16_t)std::lround(glm::clamp(v, 0.f, 1.f) * 65535.f);
+}
+
+inline int8_t toSnorm8(float v)
+{
+	return (int8_t)std::lround(glm::clamp(v, -1.f, 1.f) * 127.f);
+}
+
+// Like GL: -32768 and -128 decode to -1 too
+inline float fromSnorm(int value, float max)
+{
+	return std::max(value / max, -1.f);
+}
+
+}
+
+glm::vec2 octEncode(const glm::vec3& normal)
+{
+	const float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (l1 == 0.f)
+		return glm::vec2(0.f);
+	glm::vec2 p(normal.x / l1, normal.y / l1);
+	if (normal.z < 0.f)
+		p = glm::vec2((1.f - std::fabs(p.y)) * signNotZero(p.x), (1.f - std::fabs(p.x)) * signNotZero(p.y));
+	return p;
+}
+
+glm::vec3 octDecode(const glm::vec2& e)
+{
+	glm::vec3 v(e.x, e.y, 1.f - std::fabs(e.x) - std::fabs(e.y));
+	if (v.z < 0.f)
+	{
+		const float x = v.x;
+		v.x = (1.f - std::fabs(v.y)) * signNotZero(x);
+		v.y = (1.f - std::fabs(x)) * signNotZero(v.y);
+	}
+	return glm::normalize(v);
+}
+
+std::vector<QuantizedVertex> quantizeVertices(const MeshView& mesh)
+{
+	const glm::vec3 extent = mesh.bounds.max - mesh.bounds.min;
+	const glm::vec3 scale(
+		extent.x > 0.f ? 1.f / extent.x : 0.f,
+		extent.y > 0.f ? 1.f / extent.y : 0.f,
+		extent.z > 0.f ? 1.f / extent.z : 0.f);
+
+	std::vector<QuantizedVertex> vertices(mesh.vertexCount);
+	for (size_t i = 0; i < mesh.vertexCount; i++)
+	{
+		QuantizedVertex& q = vertices[i];
+		const glm::vec3 p = (mesh.positions[i] - mesh.bounds.min) * scale;
+		q.position[0] = toUnorm16(p.x);
+		q.position[1] = toUnorm16(p.y);
+		q.position[2] = toUnorm16(p.z);
+		q.position[3] = 0;
+
+		const glm::vec2 n = octEncode(mesh.normals[i]);
+		q.normal[0] = toSnorm16(n.x);
+		q.normal[1] = toSnorm16(n.y);
+
+		q.uv[0] = floatToHalf(mesh.uvs[i].x);
+		q.uv[1] = floatToHalf(mesh.uvs[i].y);
+	}
+	return vertices;
+}
+
+std::vector<QuantizedTangent> quantizeTangents(const MeshView& mesh)
+{
+	std::vector<QuantizedTangent> tangents(mesh.tangents ? mesh.vertexCount : 0);
+	for (size_t i = 0; i < tangents.size(); i++)
+	{
+		const glm::vec4& t = mesh.tangents[i];
+		tangents[i] = { { toSnorm8(t.x), toSnorm8(t.y), toSnorm8(t.z), (int8_t)(t.w < 0.f ? -127 : 127) } };
+	}
+	return tangents;
+}
+
+void dequantizeVertex(const QuantizedVertex& vertex, const Bounds& bounds, glm::vec3& position, glm::vec3& normal, glm::vec2& uv)
+{
+	const glm::vec3 p(vertex.position[0], vertex.position[1], vertex.position[2]);
+	position = bounds.min + p / 65535.f * (bounds.max - bounds.min);
+	normal = octDecode(glm::vec2(fromSnorm(vertex.normal[0], 32767.f), fromSnorm(vertex.normal[1], 32767.f)));
+	uv = glm::vec2(halfToFloat(vertex.uv[0]), halfToFloat(vertex.uv[1]));
+}
+
+glm::vec4 dequantizeTangent(const QuantizedTangent& tangent)
+{
+	const glm::vec3 t(fromSnorm(tangent.value[0], 127.f), fromSnorm(tangent.value[1], 127.f), fromSnorm(tangent.value[2], 127.f));
+	const float length = glm::length(t);
+	return glm::vec4(length > 0.f ? t / length : glm::vec3(1.f, 0.f, 0.f), tangent.value[3] < 0 ? -1.f : 1.f);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// 16-byte compressed vertex:
+// - position as unorm16x3 relative to the mesh bounds (w is padding)
+// - normal octahedral-encoded as snorm16x2
+// - uv as two half floats
+struct QuantizedVertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t uv[2];
+};
+static_assert(sizeof(QuantizedVertex) == 16, "quantized vertices must stay 16 bytes");
+
+// Tangent as snorm8x4, w being the bitangent sign
+struct QuantizedTangent
+{
+	int8_t value[4];
+};
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+glm::vec2 octEncode(const glm::vec3& normal);
+glm::vec3 octDecode(const glm::vec2& encoded);
+
+// Quantizes every vertex of the mesh; positions map bounds.min..bounds.max to 0..65535
+std::vector<QuantizedVertex> quantizeVertices(const MeshView& mesh);
+
+std::vector<QuantizedTangent> quantizeTangents(const MeshView& mesh);
+
+// Back to floats, up to the quantization error
+void dequantizeVertex(const QuantizedVertex& vertex, const Bounds& bounds, glm::vec3& position, glm::vec3& normal, glm::vec2& uv);
+glm::vec4 dequantizeTangent(const QuantizedTangent& tangent);
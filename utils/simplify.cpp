@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+#include "simplify.h"
+#include "meshopt.h"
+#include "Timer.h"
+
+namespace {
+
+// Symmetric 4x4 error quadric, plus the total weight it was built with so
+// that errors come out as distances
+struct Quadric
+{
+	double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+	double b0 = 0, b1 = 0, b2 = 0, c = 0;
+	double weight = 0;
+
+	void addPlane(const glm::vec3& n, float d, double w)
+	{
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+		b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+		c += w * d * d;
+		weight += w;
+	}
+
+	void add(const Quadric& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+		weight += q.weight;
+	}
+
+	// Weighted mean squared distance of p to the planes
+	double evaluate(const glm::vec3& p) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		const double e = x * x * a00 + y * y * a11 + z * z * a22
+			+ 2 * (x * y * a01 + x * z * a02 + y * z * a12)
+			+ 2 * (x * b0 + y * b1 + z * b2) + c;
+		return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+	}
+};
+
+enum class VertexKind : uint8_t
+{
+	Manifold, // interior vertex, collapses anywhere
+	Border,   // on an open border, collapses along it
+	Seam,     // one of two vertices sharing a position, collapses with its twin along the seam
+	Locked    // anything more complex, never collapses
+};
+
+inline uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+	return ((uint64_t)a << 32) | b;
+}
+
+inline bool hasEdge(const std::vector<uint64_t>& edges, uint32_t a, uint32_t b)
+{
+	return std::binary_search(edges.begin(), edges.end(), edgeKey(a, b));
+}
+
+const uint32_t kNone = ~0u;
+
+struct Collapse
+{
+	uint32_t v, t;
+	float cost;
+};
+
+}
+
+float simplifyIndices(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float maxError, std::vector<uint32_t>& destination)
+{
+	destination = indices;
+	const size_t vertexCount = positions.size();
+	if (indices.size() <= targetIndexCount)
+		return 0.f;
+
+	// Vertices sharing a position: group is the first of them, twin the next one in the group
+	std::vector<uint32_t> group(vertexCount), twin(vertexCount);
+	{
+		std::vector<uint32_t> order(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			order[v] = (uint32_t)v;
+		auto less = [&](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& p = positions[a];
+			const glm::vec3& q = positions[b];
+			return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+		};
+		std::sort(order.begin(), order.end(), less);
+		for (size_t i = 0; i < vertexCount;)
+		{
+			size_t j = i + 1;
+			while (j < vertexCount && positions[order[j]] == positions[order[i]])
+				j++;
+			for (size_t k = i; k < j; k++)
+			{
+				group[order[k]] = order[i];
+				twin[order[k]] = order[k + 1 < j ? k + 1 : i];
+			}
+			i = j;
+		}
+	}
+
+	// Half edges by vertex and by position, to find open edges
+	std::vector<uint64_t> edges, positionEdges;
+	edges.reserve(indices.size());
+	positionEdges.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+			edges.push_back(edgeKey(a, b));
+			positionEdges.push_back(edgeKey(group[a], group[b]));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	std::sort(positionEdges.begin(), positionEdges.end());
+
+	// openOut/openIn: the other end of the vertex's open edge, seam tells
+	// whether those edges have a twin across a seam
+	std::vector<uint32_t> openOut(vertexCount, kNone), openIn(vertexCount, kNone);
+	std::vector<uint8_t> openCount(vertexCount, 0), seamCount(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+			if (hasEdge(edges, b, a))
+				continue;
+			const bool seam = hasEdge(positionEdges, group[b], group[a]);
+			openOut[a] = b;
+			openIn[b] = a;
+			openCount[a] = (uint8_t)std::min(openCount[a] + 1, 15);
+			openCount[b] = (uint8_t)std::min(openCount[b] + 1, 15);
+			seamCount[a] += seam;
+			seamCount[b] += seam;
+		}
+	}
+
+	std::vector<VertexKind> kind(vertexCount, VertexKind::Locked);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const bool alone = twin[v] == v;
+		const bool pair = !alone && twin[twin[v]] == v;
+		if (alone && openCount[v] == 0)
+			kind[v] = VertexKind::Manifold;
+		else if (alone && openCount[v] == 2 && seamCount[v] == 0 && openOut[v] != kNone && openIn[v] != kNone)
+			kind[v] = VertexKind::Border;
+		else if (pair && openCount[v] == 2 && seamCount[v] == 2 && openCount[twin[v]] == 2 && seamCount[twin[v]] == 2)
+			kind[v] = VertexKind::Seam;
+	}
+
+	// Vertex quadrics, per position: triangle planes weighted by area, plus
+	// planes perpendicular to open borders so that they keep their shape
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const glm::vec3& p0 = positions[indices[i]];
+		const glm::vec3 n = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+		const float area = glm::length(n);
+		if (area == 0.f)
+			continue;
+		const glm::vec3 normal = n / area;
+		for (int k = 0; k < 3; k++)
+			quadrics[group[indices[i + k]]].addPlane(normal, -glm::dot(normal, p0), area);
+
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+			if (openOut[a] != b || kind[a] == VertexKind::Seam)
+				continue;
+			const glm::vec3 edge = positions[b] - positions[a];
+			const float length = glm::length(edge);
+			if (length == 0.f)
+				continue;
+			const glm::vec3 side = glm::normalize(glm::cross(edge, normal));
+			const double weight = 10.0 * length * length;
+			quadrics[group[a]].addPlane(side, -glm::dot(side, positions[a]), weight);
+			quadrics[group[b]].addPlane(side, -glm::dot(side, positions[a]), weight);
+		}
+	}
+
+	const double maxCost = (double)maxError * maxError;
+	double worst = 0.0;
+
+	std::vector<uint32_t> collapse(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> offsets(vertexCount + 1), adjacency;
+	std::vector<Collapse> candidates;
+
+	// The twin's end of the seam edge v-t, or kNone
+	auto seamTarget = [&](uint32_t v, uint32_t t)
+	{
+		const uint32_t s = twin[v];
+		if (openOut[v] == t && openIn[s] != kNone && group[openIn[s]] == group[t])
+			return openIn[s];
+		if (openIn[v] == t && openOut[s] != kNone && group[openOut[s]] == group[t])
+			return openOut[s];
+		return kNone;
+	};
+
+	auto canCollapse = [&](uint32_t v, uint32_t t)
+	{
+		switch (kind[v])
+		{
+		case VertexKind::Manifold: return true;
+		case VertexKind::Border: return openOut[v] == t || openIn[v] == t;
+		case VertexKind::Seam: return seamTarget(v, t) != kNone;
+		default: return false;
+		}
+	};
+
+	// Moving v onto target must not turn any of its other triangles over
+	auto flips = [&](uint32_t v, uint32_t target)
+	{
+		const glm::vec3& p = positions[target];
+		for (uint32_t j = offsets[v]; j < offsets[v + 1]; j++)
+		{
+			const uint32_t* tri = &destination[adjacency[j] * 3];
+			if (tri[0] == target || tri[1] == target || tri[2] == target)
+				continue;
+			const int k = tri[0] == v ? 0 : tri[1] == v ? 1 : 2;
+			const glm::vec3& a = positions[tri[(k + 1) % 3]];
+			const glm::vec3& b = positions[tri[(k + 2) % 3]];
+			const glm::vec3& o = positions[v];
+			const glm::vec3 before = glm::cross(a - o, b - o);
+			const glm::vec3 after = glm::cross(a - p, b - p);
+			if (glm::dot(before, after) <= 1e-2f * glm::length(before) * glm::length(after))
+				return true;
+		}
+		return false;
+	};
+
+	// The open edge through v now ends at target
+	auto collapseVertex = [&](uint32_t v, uint32_t target)
+	{
+		collapse[v] = target;
+		if (openOut[v] == target)
+			openIn[target] = openIn[v];
+		if (openIn[v] == target)
+			openOut[target] = openOut[v];
+	};
+
+	while (destination.size() > targetIndexCount)
+	{
+		const size_t triangleCount = destination.size() / 3;
+
+		// Triangles of every vertex
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t v : destination)
+			offsets[v + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(destination.size());
+		{
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < destination.size(); i++)
+				adjacency[fill[destination[i]]++] = (uint32_t)(i / 3);
+		}
+
+		// Cheapest valid direction of every edge
+		candidates.clear();
+		for (size_t i = 0; i < destination.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t a = destination[i + k], b = destination[i + (k + 1) % 3];
+				const bool ab = canCollapse(a, b), ba = canCollapse(b, a);
+				const double costAB = ab ? quadrics[group[a]].evaluate(positions[b]) : 0.0;
+				const double costBA = ba ? quadrics[group[b]].evaluate(positions[a]) : 0.0;
+				if (ab && (!ba || costAB <= costBA))
+					candidates.push_back({ a, b, (float)costAB });
+				else if (ba)
+					candidates.push_back({ b, a, (float)costBA });
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		// Each collapse removes about two triangles; vertices next to a
+		// collapse wait for the next pass
+		const size_t goal = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		for (size_t v = 0; v < vertexCount; v++)
+			collapse[v] = (uint32_t)v;
+		std::fill(touched.begin(), touched.end(), false);
+		size_t collapses = 0;
+		for (const Collapse& c : candidates)
+		{
+			if (collapses >= goal || c.cost > maxCost)
+				break;
+			if (touched[group[c.v]] || touched[group[c.t]])
+				continue;
+			const uint32_t twinTarget = kind[c.v] == VertexKind::Seam ? seamTarget(c.v, c.t) : kNone;
+			if (flips(c.v, c.t) || (twinTarget != kNone && flips(twin[c.v], twinTarget)))
+				continue;
+
+			collapseVertex(c.v, c.t);
+			if (twinTarget != kNone)
+				collapseVertex(twin[c.v], twinTarget);
+			quadrics[group[c.t]].add(quadrics[group[c.v]]);
+			touched[group[c.v]] = touched[group[c.t]] = true;
+			worst = std::max(worst, (double)c.cost);
+			collapses++;
+		}
+		if (collapses == 0)
+			break;
+
+		// Rewrite the triangles, dropping the ones that lost an edge
+		size_t write = 0;
+		for (size_t i = 0; i < destination.size(); i += 3)
+		{
+			const uint32_t a = collapse[destination[i]], b = collapse[destination[i + 1]], c = collapse[destination[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		destination.resize(write);
+
+		// Borders and seams follow their collapsed neighbours
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (openOut[v] != kNone)
+				openOut[v] = collapse[openOut[v]];
+			if (openIn[v] != kNone)
+				openIn[v] = collapse[openIn[v]];
+		}
+	}
+
+	return (float)std::sqrt(worst);
+}
+
+void buildLods(Mesh& mesh, float maxError)
+{
+	Timer timer;
+	const Bounds bounds = computeBounds(mesh.positions);
+	const glm::vec3 size = bounds.max - bounds.min;
+	const float budget = maxError * std::max(size.x, std::max(size.y, size.z));
+
+	mesh.lods.clear();
+	mesh.lods.push_back({ 0, (uint32_t)mesh.indices.size(), 0.f });
+
+	std::vector<uint32_t> current(mesh.indices), next;
+	float error = 0.f;
+	while (mesh.lods.size() < kMaxMeshLods && error < budget)
+	{
+		const size_t target = current.size() / 6 * 3;
+		const float levelError = simplifyIndices(mesh.positions, current, target, budget - error, next);
+		// Not worth a level if it saves less than a fifth of the triangles
+		if (next.empty() || next.size() * 5 > current.size() * 4)
+			break;
+
+		// Errors measure the distance to the previous level, so they add up
+		error += levelError;
+		optimizeVertexCache(next, mesh.vertexCount());
+		mesh.lods.push_back({ (uint32_t)mesh.indices.size(), (uint32_t)next.size(), error });
+		mesh.indices.insert(mesh.indices.end(), next.begin(), next.end());
+		current.swap(next);
+	}
+
+	printf("Built %zu levels of detail in %.3f s:", mesh.lods.size(), timer.elapsed());
+	for (const MeshLod& lod : mesh.lods)
+		printf(" %u", lod.indexCount / 3);
+	printf(" triangles, error up to %.4f\n", mesh.lods.back().error);
+}
+
+size_t selectLod(const MeshLod* lods, size_t count, float pixelsPerUnit, float maxPixels)
+{
+	size_t level = 0;
+	while (level + 1 < count && lods[level + 1].error * pixelsPerUnit <= maxPixels)
+		level++;
+	return level;
+}
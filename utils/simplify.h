@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Quadric edge collapse (Garland & Heckbert) over an index buffer: vertices
+// are collapsed onto their neighbours, never moved, so the result indexes the
+// same vertex streams. Open borders only collapse along themselves, and
+// attribute seams (vertices sharing a position) collapse in pairs along the
+// seam, so they stay watertight. Stops at targetIndexCount or before a
+// collapse would move the surface more than maxError (model units), and
+// returns the largest error of the collapses done.
+float simplifyIndices(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float maxError, std::vector<uint32_t>& destination);
+
+// Appends up to kMaxMeshLods - 1 coarser levels to mesh.indices, each one
+// halving the triangles of the previous, until the accumulated error passes
+// maxError (relative to the mesh extent) or simplification stalls. Level 0 is
+// the full mesh.
+void buildLods(Mesh& mesh, float maxError = 0.1f);
+
+// Coarsest level whose error, scaled by pixelsPerUnit to screen (or shadow
+// map) pixels, stays under maxPixels
+size_t selectLod(const MeshLod* lods, size_t count, float pixelsPerUnit, float maxPixels);
@@ -0,0 +1,26 @@
+#include <filesystem>
+
+#include "sourceinfo.h"
+#include "hash.h"
+#include "MappedFile.h"
+
+bool getSourceInfo(const char* path, SourceInfo& info, bool withHash)
+{
+	std::error_code error;
+	info.size = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	info.time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	if (error)
+		return false;
+
+	info.hash = 0;
+	if (withHash)
+	{
+		MappedFile file(path);
+		if (!file.isOpen())
+			return false;
+		info.hash = hash64(file.data(), file.size());
+	}
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Size, modification time and hash of the file an asset was built from,
+// recorded with it to detect stale caches
+struct SourceInfo
+{
+	uint64_t size = 0;
+	int64_t time = 0;
+	uint64_t hash = 0;
+};
+
+// Fills size and time; the hash is only computed when asked for since it
+// means reading the whole file
+bool getSourceInfo(const char* path, SourceInfo& info, bool withHash);
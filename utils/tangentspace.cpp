@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+#include <vector>
+
+#include "tangentspace.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENTSPACE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const size_t kTrianglesPerJob = 1 << 14;
+const size_t kVerticesPerJob = 1 << 14;
+
+// Four lanes processed at once, with SSE when the target has it
+#ifdef TANGENTSPACE_SSE
+
+struct Float4
+{
+	__m128 v;
+};
+
+inline Float4 load4(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void store4(float* p, Float4 a) { _mm_storeu_ps(p, a.v); }
+inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+
+// 1 where positive, -1 where negative, 0 elsewhere
+inline Float4 sign4(Float4 a)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 positive = _mm_and_ps(_mm_cmpgt_ps(a.v, zero), _mm_set1_ps(1.f));
+	const __m128 negative = _mm_and_ps(_mm_cmplt_ps(a.v, zero), _mm_set1_ps(-1.f));
+	return { _mm_or_ps(positive, negative) };
+}
+
+#else
+
+struct Float4
+{
+	float v[4];
+};
+
+inline Float4 load4(const float* p) { Float4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void store4(float* p, Float4 a) { memcpy(p, a.v, sizeof(a.v)); }
+inline Float4 operator+(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline Float4 operator-(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline Float4 operator*(Float4 a, Float4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+
+inline Float4 sign4(Float4 a)
+{
+	for (int i = 0; i < 4; i++)
+		a.v[i] = a.v[i] > 0.f ? 1.f : a.v[i] < 0.f ? -1.f : 0.f;
+	return a;
+}
+
+#endif
+
+// Structure of arrays: one vector per lane
+struct Vec3x4
+{
+	Float4 x, y, z;
+};
+
+inline Vec3x4 operator-(const Vec3x4& a, const Vec3x4& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3x4 operator*(const Vec3x4& a, Float4 s) { return { a.x * s, a.y * s, a.z * s }; }
+
+inline Vec3x4 cross4(const Vec3x4& a, const Vec3x4& b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// Attribute of one corner of count (at most 4) consecutive triangles, the
+// missing lanes being zero
+Vec3x4 gather3(const glm::vec3* stream, const uint32_t* indices, size_t triangle, unsigned corner, size_t count)
+{
+	float x[4] = {}, y[4] = {}, z[4] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		const glm::vec3& p = stream[indices[(triangle + i) * 3 + corner]];
+		x[i] = p.x;
+		y[i] = p.y;
+		z[i] = p.z;
+	}
+	return { load4(x), load4(y), load4(z) };
+}
+
+void gather2(const glm::vec2* stream, const uint32_t* indices, size_t triangle, unsigned corner, size_t count, Float4& u, Float4& v)
+{
+	float x[4] = {}, y[4] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		const glm::vec2& t = stream[indices[(triangle + i) * 3 + corner]];
+		x[i] = t.x;
+		y[i] = t.y;
+	}
+	u = load4(x);
+	v = load4(y);
+}
+
+// Runs block(first, last) over [0, count) in jobs of blockSize on the shared pool
+template <class Block>
+void parallelBlocks(size_t count, size_t blockSize, const Block& block)
+{
+	ThreadPool::shared().parallelFor((count + blockSize - 1) / blockSize, [&](size_t job)
+	{
+		block(job * blockSize, std::min(count, (job + 1) * blockSize));
+	});
+}
+
+// Corners around each vertex: those of vertex v are corners[offsets[v]] to
+// corners[offsets[v + 1]], in increasing order so that sums are the same
+// whatever the number of threads
+struct VertexCorners
+{
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> corners;
+};
+
+VertexCorners buildVertexCorners(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	VertexCorners result;
+	result.offsets.assign(vertexCount + 1, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		result.offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		result.offsets[v + 1] += result.offsets[v];
+
+	std::vector<uint32_t> next(result.offsets.begin(), result.offsets.end() - 1);
+	result.corners.resize(indexCount);
+	for (size_t i = 0; i < indexCount; i++)
+		result.corners[next[indices[i]]++] = (uint32_t)i;
+	return result;
+}
+
+// Cross products of the triangle edges: their length is twice the area
+std::vector<glm::vec3> computeFaceNormals(const glm::vec3* positions, const uint32_t* indices, size_t triangleCount)
+{
+	std::vector<glm::vec3> faces(triangleCount);
+	parallelBlocks(triangleCount, kTrianglesPerJob, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t += 4)
+		{
+			const size_t count = std::min<size_t>(4, last - t);
+			const Vec3x4 p0 = gather3(positions, indices, t, 0, count);
+			const Vec3x4 p1 = gather3(positions, indices, t, 1, count);
+			const Vec3x4 p2 = gather3(positions, indices, t, 2, count);
+			const Vec3x4 n = cross4(p1 - p0, p2 - p0);
+
+			float x[4], y[4], z[4];
+			store4(x, n.x);
+			store4(y, n.y);
+			store4(z, n.z);
+			for (size_t i = 0; i < count; i++)
+				faces[t + i] = glm::vec3(x[i], y[i], z[i]);
+		}
+	});
+	return faces;
+}
+
+// Triangle tangents along increasing u, flipped where the uv mapping is
+// mirrored; w holds that orientation, 0 for triangles without uv area
+std::vector<glm::vec4> computeFaceTangents(const glm::vec3* positions, const glm::vec2* uvs, const uint32_t* indices, size_t triangleCount)
+{
+	std::vector<glm::vec4> faces(triangleCount);
+	parallelBlocks(triangleCount, kTrianglesPerJob, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t += 4)
+		{
+			const size_t count = std::min<size_t>(4, last - t);
+			const Vec3x4 p0 = gather3(positions, indices, t, 0, count);
+			const Vec3x4 e1 = gather3(positions, indices, t, 1, count) - p0;
+			const Vec3x4 e2 = gather3(positions, indices, t, 2, count) - p0;
+
+			Float4 u0, v0, u1, v1, u2, v2;
+			gather2(uvs, indices, t, 0, count, u0, v0);
+			gather2(uvs, indices, t, 1, count, u1, v1);
+			gather2(uvs, indices, t, 2, count, u2, v2);
+			const Float4 du1 = u1 - u0, dv1 = v1 - v0;
+			const Float4 du2 = u2 - u0, dv2 = v2 - v0;
+
+			const Float4 orientation = sign4(du1 * dv2 - du2 * dv1);
+			const Vec3x4 tangent = (e1 * dv2 - e2 * dv1) * orientation;
+
+			float x[4], y[4], z[4], w[4];
+			store4(x, tangent.x);
+			store4(y, tangent.y);
+			store4(z, tangent.z);
+			store4(w, orientation);
+			for (size_t i = 0; i < count; i++)
+				faces[t + i] = glm::vec4(x[i], y[i], z[i], w[i]);
+		}
+	});
+	return faces;
+}
+
+inline glm::vec3 projectOnPlane(const glm::vec3& v, const glm::vec3& normal)
+{
+	return v - normal * glm::dot(normal, v);
+}
+
+// Any unit vector orthogonal to normal
+glm::vec3 orthogonal(const glm::vec3& normal)
+{
+	const glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+	return glm::normalize(projectOnPlane(axis, normal));
+}
+
+void printTime(const char* what, size_t triangles, float seconds)
+{
+	printf("Generated %s for %zu triangles in %.2f ms (%.1f ms per million triangles)\n",
+		what, triangles, seconds * 1000.f, triangles ? seconds * 1e9f / triangles : 0.f);
+}
+
+}
+
+void generateNormals(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, glm::vec3* normals)
+{
+	Timer timer;
+	const size_t triangleCount = indexCount / 3;
+	const std::vector<glm::vec3> faces = computeFaceNormals(positions, indices, triangleCount);
+	const VertexCorners around = buildVertexCorners(indices, triangleCount * 3, vertexCount);
+
+	parallelBlocks(vertexCount, kVerticesPerJob, [&](size_t first, size_t last)
+	{
+		for (size_t v = first; v < last; v++)
+		{
+			glm::vec3 sum(0.f);
+			for (uint32_t i = around.offsets[v]; i < around.offsets[v + 1]; i++)
+				sum += faces[around.corners[i] / 3];
+			const float length = glm::length(sum);
+			normals[v] = length > 0.f ? sum / length : glm::vec3(0.f, 1.f, 0.f);
+		}
+	});
+	printTime("normals", triangleCount, timer.elapsed());
+}
+
+void generateTangents(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* uvs, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, glm::vec4* tangents)
+{
+	Timer timer;
+	const size_t triangleCount = indexCount / 3;
+	const std::vector<glm::vec4> faces = computeFaceTangents(positions, uvs, indices, triangleCount);
+	const VertexCorners around = buildVertexCorners(indices, triangleCount * 3, vertexCount);
+
+	parallelBlocks(vertexCount, kVerticesPerJob, [&](size_t first, size_t last)
+	{
+		for (size_t v = first; v < last; v++)
+		{
+			const glm::vec3& normal = normals[v];
+			glm::vec3 sum(0.f);
+			float orientation = 0.f;
+			for (uint32_t i = around.offsets[v]; i < around.offsets[v + 1]; i++)
+			{
+				const uint32_t corner = around.corners[i];
+				const glm::vec4& face = faces[corner / 3];
+				if (face.w == 0.f)
+					continue;
+
+				glm::vec3 tangent = projectOnPlane(glm::vec3(face.x, face.y, face.z), normal);
+				const float length = glm::length(tangent);
+				if (length == 0.f)
+					continue;
+
+				// Angle at this corner, between the edges projected like the normal
+				const uint32_t base = corner - corner % 3;
+				const glm::vec3& p = positions[indices[corner]];
+				glm::vec3 e1 = projectOnPlane(positions[indices[base + (corner + 1) % 3]] - p, normal);
+				glm::vec3 e2 = projectOnPlane(positions[indices[base + (corner + 2) % 3]] - p, normal);
+				const float lengths = glm::length(e1) * glm::length(e2);
+				const float angle = lengths > 0.f ? std::acos(glm::clamp(glm::dot(e1, e2) / lengths, -1.f, 1.f)) : 0.f;
+
+				sum += tangent * (angle / length);
+				orientation += face.w * angle;
+			}
+
+			const float length = glm::length(sum);
+			const glm::vec3 tangent = length > 0.f ? sum / length : orthogonal(normal);
+			tangents[v] = glm::vec4(tangent.x, tangent.y, tangent.z, orientation < 0.f ? -1.f : 1.f);
+		}
+	});
+	printTime("tangents", triangleCount, timer.elapsed());
+}
+
+void computeNormals(Mesh& mesh)
+{
+	mesh.normals.resize(mesh.vertexCount());
+	generateNormals(mesh.positions.data(), mesh.vertexCount(), mesh.indices.data(), mesh.indices.size(), mesh.normals.data());
+}
+
+void computeTangents(Mesh& mesh)
+{
+	if (mesh.normals.size() != mesh.vertexCount() || mesh.uvs.size() != mesh.vertexCount())
+	{
+		mesh.tangents.clear();
+		return;
+	}
+	mesh.tangents.resize(mesh.vertexCount());
+	generateTangents(mesh.positions.data(), mesh.normals.data(), mesh.uvs.data(), mesh.vertexCount(),
+		mesh.indices.data(), mesh.indices.size(), mesh.tangents.data());
+}
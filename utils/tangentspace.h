@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Smooth vertex normals: sum of the normals of the triangles around each
+// vertex, weighted by their area. Vertices no triangle uses get (0, 1, 0).
+void generateNormals(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, glm::vec3* normals);
+
+// Vertex tangents following the MikkTSpace conventions, so that normal maps
+// baked by the usual tools decode the same way: triangle tangents point along
+// increasing u, are projected on the vertex normal plane and weighted by the
+// corner angle. w is the bitangent sign, bitangent = w * cross(normal, tangent).
+void generateTangents(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* uvs, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, glm::vec4* tangents);
+
+void computeNormals(Mesh& mesh);
+
+// Needs normals and uvs, leaves the mesh without tangents otherwise
+void computeTangents(Mesh& mesh);
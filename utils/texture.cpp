@@ -1,17 +1,127 @@
-#include <CImg.h>
+#include <cstring>
+#include <stdio.h>
 
 #include "texture.h"
+#include "MappedFile.h"
+#include "stb_image.h"
 
-Image LoadImage(const char* filename)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_SSE 1
+#include <emmintrin.h>
+#endif
+// MSVC has no SSSE3 switch short of /arch:AVX: the x64 projects opt in with
+// ENABLE_SSSE3 instead
+#if defined(__SSSE3__) || defined(__AVX__) || (defined(ENABLE_SSSE3) && defined(TEXTURE_SSE))
+#define TEXTURE_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+namespace {
+
+// RGBA <-> BGRA, four texels at a time
+void swapRedBlue4(const uint8_t* in, uint8_t* out, size_t texels)
 {
-	cimg_library::CImg<unsigned char> im(filename);
+	size_t i = 0;
+#ifdef TEXTURE_SSE
+	const __m128i greenAlpha = _mm_set1_epi32((int)0xFF00FF00);
+	const __m128i low = _mm_set1_epi32(0xFF);
+	for (; i + 4 <= texels; i += 4)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)(in + i * 4));
+		const __m128i red = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+		const __m128i blue = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+		_mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(_mm_and_si128(v, greenAlpha), _mm_or_si128(red, blue)));
+	}
+#endif
+	for (; i < texels; i++)
+	{
+		out[i * 4 + 0] = in[i * 4 + 2];
+		out[i * 4 + 1] = in[i * 4 + 1];
+		out[i * 4 + 2] = in[i * 4 + 0];
+		out[i * 4 + 3] = in[i * 4 + 3];
+	}
+}
 
-	std::vector<unsigned char> picture;
-	cimg_forXY(im, x, y) {
-		picture.push_back(im(x, im.height() - y - 1, 0, 0));
-		picture.push_back(im(x, im.height() - y - 1, 0, 1));
-		picture.push_back(im(x, im.height() - y - 1, 0, 2));
+// RGB <-> BGR, five texels at a time; each store spills one byte into the
+// next texel, rewritten by the next step
+void swapRedBlue3(const uint8_t* in, uint8_t* out, size_t texels)
+{
+	size_t i = 0;
+#ifdef TEXTURE_SSSE3
+	const __m128i order = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+	for (; i * 3 + 16 <= texels * 3; i += 5)
+		_mm_storeu_si128((__m128i*)(out + i * 3), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i * 3)), order));
+#endif
+	for (; i < texels; i++)
+	{
+		out[i * 3 + 0] = in[i * 3 + 2];
+		out[i * 3 + 1] = in[i * 3 + 1];
+		out[i * 3 + 2] = in[i * 3 + 0];
 	}
+}
+
+}
+
+uint32_t channelCount(PixelFormat format)
+{
+	return format == PixelFormat::RGB || format == PixelFormat::BGR ? 3 : 4;
+}
 
-	return { picture, im.width(), im.height() };
+bool imageInfo(const char* data, size_t size, int& width, int& height, int* channels)
+{
+	int sourceChannels;
+	return stbi_info_from_memory((const stbi_uc*)data, (int)size, &width, &height, channels ? channels : &sourceChannels) != 0;
+}
+
+bool decodeImage(const char* data, size_t size, PixelFormat format, bool flip, uint8_t* pixels, size_t capacity)
+{
+	// stb converts the channel count, the order and orientation are ours
+	const int channels = (int)channelCount(format);
+	int width, height, sourceChannels;
+	stbi_uc* decoded = stbi_load_from_memory((const stbi_uc*)data, (int)size, &width, &height, &sourceChannels, channels);
+	if (!decoded)
+		return false;
+	const size_t rowBytes = (size_t)width * channels;
+	if (rowBytes * height > capacity)
+	{
+		stbi_image_free(decoded);
+		return false;
+	}
+
+	const bool swizzle = format == PixelFormat::BGR || format == PixelFormat::BGRA;
+	if (!flip && !swizzle)
+		memcpy(pixels, decoded, rowBytes * height);
+	else
+		for (int y = 0; y < height; y++)
+		{
+			const uint8_t* in = decoded + rowBytes * (flip ? height - 1 - y : y);
+			uint8_t* out = pixels + rowBytes * y;
+			if (!swizzle)
+				memcpy(out, in, rowBytes);
+			else if (channels == 4)
+				swapRedBlue4(in, out, width);
+			else
+				swapRedBlue3(in, out, width);
+		}
+	stbi_image_free(decoded);
+	return true;
+}
+
+Image LoadImage(const char* filename, PixelFormat format, bool flip)
+{
+	Image image;
+	MappedFile file(filename);
+	if (!file.isOpen() || !imageInfo(file.data(), file.size(), image.width, image.height))
+	{
+		printf("Image failed to load at path: %s\n", filename);
+		return {};
+	}
+	image.format = format;
+	image.data.resize((size_t)image.width * image.height * channelCount(format));
+	if (!decodeImage(file.data(), file.size(), format, flip, image.data.data(), image.data.size()))
+	{
+		printf("Image failed to decode at path: %s\n", filename);
+		return {};
+	}
+	return image;
 }
@@ -1,11 +1,35 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <vector>
-#include <tuple>
+
+// Channel order of decoded pixels, 8 bits each
+enum class PixelFormat
+{
+	RGB,
+	RGBA, // opaque images get alpha 255
+	BGR,
+	BGRA
+};
+
+uint32_t channelCount(PixelFormat format);
 
 struct Image
 {
 	std::vector<unsigned char> data;
-	int width, height;
+	int width = 0, height = 0;
+	PixelFormat format = PixelFormat::RGB;
 };
 
-Image LoadImage(const char* filename);
+// Size of an encoded image (PNG, JPEG, TGA, BMP...), and the channels it
+// holds, from its header only
+bool imageInfo(const char* data, size_t size, int& width, int& height, int* channels = nullptr);
+
+// Decodes into pixels, width * height * channelCount(format) bytes of the
+// caller (a mapped buffer for instance) sized from imageInfo; with flip, rows
+// go bottom to top like OpenGL expects. Rows are copied or swizzled whole,
+// with SSE2/SSSE3 when available.
+bool decodeImage(const char* data, size_t size, PixelFormat format, bool flip, uint8_t* pixels, size_t capacity);
+
+// Whole file, RGB rows bottom to top unless asked otherwise; empty on failure
+Image LoadImage(const char* filename, PixelFormat format = PixelFormat::RGB, bool flip = true);
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "stb_image.h"
+
+#include "texturefile.h"
+#include "bcn.h"
+#include "MappedFile.h"
+#include "mipmap.h"
+#include "Timer.h"
+
+namespace {
+
+const uint32_t kMaxTextureSize = 1u << (kMaxTextureLevels - 1);
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Of a level of every layer, as readers upload or cut it
+uint64_t levelBytes(const TextureFileHeader& header, uint32_t level)
+{
+	const uint64_t width = std::max(header.width >> level, 1u);
+	const uint64_t height = std::max(header.height >> level, 1u);
+	const uint64_t layers = std::max(header.layerCount, 1u);
+	const TextureFormat format = (TextureFormat)header.format;
+	if (format == TextureFormat::RGBA8)
+		return width * height * 4 * layers;
+	return ((width + 3) / 4) * ((height + 3) / 4) * (format == TextureFormat::BC1 ? 8 : 16) * layers;
+}
+
+bool isValid(const TextureFileHeader& header, size_t fileSize)
+{
+	if (fileSize < sizeof(TextureFileHeader) || memcmp(header.magic, "GTEX", 4) != 0 || header.version != kTextureFileVersion)
+		return false;
+	if (header.levelCount == 0 || header.levelCount > kMaxTextureLevels || header.format > (uint32_t)TextureFormat::BC7)
+		return false;
+	if (header.width == 0 || header.height == 0 || header.width > kMaxTextureSize || header.height > kMaxTextureSize)
+		return false;
+	if (header.layerCount > 1 && sizeof(TextureFileHeader) + (uint64_t)header.layerCount * sizeof(TextureLayer) > fileSize)
+		return false;
+	for (uint32_t i = 0; i < header.levelCount; i++)
+		if (header.levelSizes[i] != levelBytes(header, i) || header.levelOffsets[i] > fileSize
+			|| header.levelSizes[i] > fileSize - header.levelOffsets[i])
+			return false;
+	return true;
+}
+
+struct LevelData
+{
+	const uint8_t* data;
+	size_t size;
+};
+
+// Fills in the offsets and sizes of header and writes the file
+bool writeTextureFile(const char* outputPath, TextureFileHeader& header, const std::vector<TextureLayer>& layers, const std::vector<LevelData>& levels)
+{
+	header.layerCount = (uint32_t)layers.size();
+	header.levelCount = (uint32_t)levels.size();
+	uint64_t offset = alignUp(sizeof(header) + layers.size() * sizeof(TextureLayer), 16);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		header.levelOffsets[i] = offset;
+		header.levelSizes[i] = levels[i].size;
+		offset = alignUp(offset + levels[i].size, 16);
+	}
+
+	// Write next to the destination and rename, like mesh files
+	const std::string temporary = std::string(outputPath) + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+	static const char zeros[16] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(layers.data(), sizeof(TextureLayer), layers.size(), file) == layers.size();
+	uint64_t written = sizeof(header) + layers.size() * sizeof(TextureLayer);
+	for (size_t i = 0; ok && i < levels.size(); i++)
+	{
+		const size_t padding = (size_t)(header.levelOffsets[i] - written);
+		ok = fwrite(zeros, 1, padding, file) == padding
+			&& fwrite(levels[i].data, 1, levels[i].size, file) == levels[i].size;
+		written = header.levelOffsets[i] + header.levelSizes[i];
+	}
+	ok = fclose(file) == 0 && ok;
+
+	std::error_code error;
+	if (ok)
+		std::filesystem::rename(temporary, outputPath, error);
+	if (!ok || error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+uint32_t roundUpPow2(uint32_t value)
+{
+	uint32_t result = 1;
+	while (result < value)
+		result *= 2;
+	return result;
+}
+
+// Source unit of unit x of a layer count units wide holding a texture size
+// units wide, see TextureLayer
+uint32_t paddedUnit(uint32_t x, uint32_t size, uint32_t count, bool repeat)
+{
+	if (x < size)
+		return x;
+	const bool afterEnd = x - size < (count - size + 1) / 2;
+	if (!repeat)
+		return afterEnd ? size - 1 : 0;
+	return afterEnd ? (x - size) % size : size - 1 - (count - 1 - x) % size;
+}
+
+uint32_t floorLog2(uint32_t pow2)
+{
+	uint32_t result = 0;
+	while (pow2 > 1)
+	{
+		pow2 /= 2;
+		result++;
+	}
+	return result;
+}
+
+}
+
+bool viewTextureFile(const char* data, size_t size, TextureView& view, TextureFileHeader& header)
+{
+	if (size < sizeof(TextureFileHeader))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (!isValid(header, size))
+		return false;
+
+	view.width = header.width;
+	view.height = header.height;
+	view.format = (TextureFormat)header.format;
+	view.channels = header.channels;
+	view.levelCount = header.levelCount;
+	view.layerCount = std::max(header.layerCount, 1u);
+	view.layers = header.layerCount > 1 ? (const TextureLayer*)(data + sizeof(TextureFileHeader)) : nullptr;
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		view.levels[i] = (const uint8_t*)data + header.levelOffsets[i];
+		view.levelSizes[i] = (size_t)header.levelSizes[i];
+	}
+	return true;
+}
+
+const char* textureFormatName(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1: return "BC1";
+	case TextureFormat::BC3: return "BC3";
+	case TextureFormat::BC7: return "BC7";
+	default: return "RGBA8";
+	}
+}
+
+bool mapTextureFile(const char* path, MappedFile& file, TextureView& view, TextureFileHeader& header)
+{
+	if (!file.open(path))
+		return false;
+	if (viewTextureFile(file.data(), file.size(), view, header))
+		return true;
+	file.close();
+	return false;
+}
+
+bool cookTexture(const char* path, const char* outputPath, TextureCompression compression, const SourceInfo& source)
+{
+	MappedFile image(path);
+	if (!image.isOpen())
+	{
+		printf("Texture failed to load at path: %s\n", path);
+		return false;
+	}
+	return cookTexture(image.data(), image.size(), path, outputPath, compression, source);
+}
+
+bool cookTexture(const char* data, size_t size, const char* path, const char* outputPath, TextureCompression compression, const SourceInfo& source)
+{
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load_from_memory((const stbi_uc*)data, (int)size, &width, &height, &channels, 4);
+	if (!pixels)
+	{
+		printf("Texture failed to load at path: %s\n", path);
+		return false;
+	}
+	std::vector<ImageLevel> chain = buildMipChain(pixels, (uint32_t)width, (uint32_t)height);
+	stbi_image_free(pixels);
+	if (chain.size() > kMaxTextureLevels)
+		chain.resize(kMaxTextureLevels);
+
+	bool opaque = true;
+	for (size_t i = 3; opaque && i < chain[0].pixels.size(); i += 4)
+		opaque = chain[0].pixels[i] == 255;
+	const TextureFormat format = compression == TextureCompression::None ? TextureFormat::RGBA8
+		: compression == TextureCompression::BC7 ? TextureFormat::BC7
+		: opaque ? TextureFormat::BC1 : TextureFormat::BC3;
+	if (format != TextureFormat::RGBA8)
+	{
+		const BlockFormat blockFormat = format == TextureFormat::BC1 ? BlockFormat::BC1
+			: format == TextureFormat::BC3 ? BlockFormat::BC3 : BlockFormat::BC7;
+		const ImageLevel original = chain[0];
+		Timer timer;
+		for (ImageLevel& level : chain)
+			level.pixels = compressBlocks(level, blockFormat);
+		const float seconds = timer.elapsed();
+		const double psnr = computePsnr(original, decompressBlocks(chain[0].pixels.data(), blockFormat, width, height), !opaque);
+		printf("Compressed %s (%dx%d) to %s in %.1f ms (%.1f MP/s), PSNR %.2f dB\n", path, width, height,
+			textureFormatName(format), seconds * 1000.f, width * height * 4 / 3e6 / std::max(seconds, 1e-6f), psnr);
+	}
+
+	TextureFileHeader header = {};
+	memcpy(header.magic, "GTEX", 4);
+	header.version = kTextureFileVersion;
+	header.sourceSize = source.size;
+	header.sourceTime = source.time;
+	header.sourceHash = source.hash;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.format = (uint32_t)format;
+	header.channels = (uint32_t)channels;
+	std::vector<LevelData> levels;
+	for (const ImageLevel& level : chain)
+		levels.push_back({ level.pixels.data(), level.pixels.size() });
+	return writeTextureFile(outputPath, header, {}, levels);
+}
+
+uint64_t textureArrayClass(const TextureView& view)
+{
+	return (uint64_t)view.format << 32 | floorLog2(roundUpPow2(view.width)) << 16 | floorLog2(roundUpPow2(view.height));
+}
+
+bool writeTextureArray(const char* outputPath, const std::vector<TextureView>& textures, const std::vector<uint64_t>& sourceHashes)
+{
+	if (textures.empty() || textures.size() != sourceHashes.size())
+		return false;
+	const TextureView& first = textures[0];
+	TextureFileHeader header = {};
+	memcpy(header.magic, "GTEX", 4);
+	header.version = kTextureFileVersion;
+	header.width = roundUpPow2(first.width);
+	header.height = roundUpPow2(first.height);
+	header.format = (uint32_t)first.format;
+	std::vector<TextureLayer> layers;
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		const TextureView& texture = textures[i];
+		if (textureArrayClass(texture) != textureArrayClass(first) || texture.layerCount != 1)
+			return false;
+		layers.push_back({ sourceHashes[i], texture.width, texture.height, texture.channels, 0 });
+		header.channels = std::max(header.channels, texture.channels);
+	}
+
+	// Levels of the layer down to 1x1; textures with fewer levels repeat their last one
+	const uint32_t levelCount = std::min(floorLog2(std::max(header.width, header.height)) + 1, kMaxTextureLevels);
+	const bool blocks = first.format != TextureFormat::RGBA8;
+	const uint32_t unit = blocks ? 4 : 1; // texels
+	const size_t unitBytes = first.format == TextureFormat::BC1 ? 8 : blocks ? 16 : 4;
+	std::vector<std::vector<uint8_t>> data(levelCount);
+	std::vector<LevelData> levels;
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		const uint32_t unitsX = (std::max(header.width >> level, 1u) + unit - 1) / unit;
+		const uint32_t unitsY = (std::max(header.height >> level, 1u) + unit - 1) / unit;
+		const size_t rowBytes = unitsX * unitBytes;
+		data[level].resize(rowBytes * unitsY * layers.size());
+		uint8_t* out = data[level].data();
+		for (const TextureView& texture : textures)
+		{
+			const uint32_t source = std::min(level, texture.levelCount - 1);
+			const uint32_t sourceX = (std::max(texture.width >> source, 1u) + unit - 1) / unit;
+			const uint32_t sourceY = (std::max(texture.height >> source, 1u) + unit - 1) / unit;
+			const size_t sourceRowBytes = std::min(sourceX, unitsX) * unitBytes;
+			const bool repeat = texture.channels != 4;
+			for (uint32_t y = 0; y < unitsY; y++, out += rowBytes)
+			{
+				const uint8_t* row = texture.levels[source] + (size_t)paddedUnit(y, sourceY, unitsY, repeat) * sourceX * unitBytes;
+				memcpy(out, row, sourceRowBytes);
+				for (uint32_t x = std::min(sourceX, unitsX); x < unitsX; x++)
+					memcpy(out + x * unitBytes, row + paddedUnit(x, sourceX, unitsX, repeat) * unitBytes, unitBytes);
+			}
+		}
+		levels.push_back({ data[level].data(), data[level].size() });
+	}
+	return writeTextureFile(outputPath, header, layers, levels);
+}
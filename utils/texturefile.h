@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MappedFile.h"
+#include "sourceinfo.h"
+
+enum class TextureFormat : uint32_t
+{
+	RGBA8 = 0,
+	BC1 = 1,
+	BC3 = 2,
+	BC7 = 3
+};
+
+enum class TextureCompression
+{
+	None,
+	S3TC, // BC1, or BC3 when some texel is not opaque
+	BC7
+};
+
+const uint32_t kMaxTextureLevels = 16;
+
+// Cooked texture file, little-endian: the header, then every mip level
+// (largest first) on a 16-byte boundary, ready for glTextureSubImage2D or
+// glCompressedTextureSubImage2D. Texture arrays have a TextureLayer per layer
+// right after the header, and each of their levels holds every layer in turn
+// (glTextureSubImage3D).
+struct TextureFileHeader
+{
+	char magic[4];            // "GTEX"
+	uint32_t version;
+	uint64_t sourceSize;      // image the texture was cooked from,
+	int64_t sourceTime;       // like mesh files
+	uint64_t sourceHash;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;          // TextureFormat
+	uint32_t channels;        // of the source image, 4 when it has alpha
+	uint32_t levelCount;
+	uint32_t layerCount;      // 0 but for texture arrays
+	uint64_t levelOffsets[kMaxTextureLevels];
+	uint64_t levelSizes[kMaxTextureLevels];
+};
+
+// Texture of a texture array: its level 0 fills the top left width by height
+// texels of its layer. The array repeats, so the near half of the padding
+// continues past the end of the texture and the far half comes before its
+// start: wrapped for textures without alpha, which repeat, and the edge
+// repeated for the others, which are clamped.
+struct TextureLayer
+{
+	uint64_t sourceHash;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+	uint32_t reserved;
+};
+
+const uint32_t kTextureFileVersion = 2;
+
+// Non-owning view of the levels of a cooked texture
+struct TextureView
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	TextureFormat format = TextureFormat::RGBA8;
+	uint32_t channels = 4;
+	uint32_t levelCount = 0;
+	uint32_t layerCount = 1;
+	const TextureLayer* layers = nullptr; // of texture arrays
+	const uint8_t* levels[kMaxTextureLevels] = {};
+	size_t levelSizes[kMaxTextureLevels] = {};
+};
+
+bool viewTextureFile(const char* data, size_t size, TextureView& view, TextureFileHeader& header);
+bool mapTextureFile(const char* path, MappedFile& file, TextureView& view, TextureFileHeader& header);
+
+// Decodes an image (anything stb_image reads) and writes it with its whole
+// mip chain (gamma-correct Kaiser, see mipmap.h), block compressed unless
+// compression is None. Compressed textures get a report line: encoding time
+// and PSNR of the first level.
+bool cookTexture(const char* path, const char* outputPath, TextureCompression compression, const SourceInfo& source);
+// Same from the bytes of the image at path
+bool cookTexture(const char* data, size_t size, const char* path, const char* outputPath, TextureCompression compression, const SourceInfo& source);
+
+// Textures of the same format whose sides round up to the same powers of two
+// have the same class, and can share a texture array
+uint64_t textureArrayClass(const TextureView& view);
+
+// Writes textures of the same class as the layers of a texture array, its
+// layers being their sides rounded up to powers of two; sourceHashes are the
+// hashes of their images
+bool writeTextureArray(const char* outputPath, const std::vector<TextureView>& textures, const std::vector<uint64_t>& sourceHashes);
+
+const char* textureFormatName(TextureFormat format);